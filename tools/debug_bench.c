@@ -0,0 +1,337 @@
+/*
+ * debug_bench - runs the debug output on the host and measures it end to end
+ *
+ * Links uart_debug.c against the emulated uart and the stand-in getters of
+ * tools/host, and calls debug_process in a main loop like the firmware does.
+ * Extra debug_printf lines can be added as synthetic load, and alarm lines to
+ * measure how long they wait behind the other lanes. At the end it reports
+ * the lines and bytes per second on the uart, and the time spent in the debug
+ * calls per call and per byte.
+ *
+ * Build:   cc -O2 -pthread -I.. -Ihost -o debug_bench debug_bench.c host/uart_debug_host.c host/app_stubs.c ../uart_debug.c ../utl.c
+ * Usage:   debug_bench [-t seconds] [-m ascii|binary|trace] [-r rate] [-l lines per ms] [-a alarms per s] [-o out] [-c command]...
+ *          debug_bench -i | -p producers
+ *          -r 0 sends without a data rate limit, -o writes the uart output to a file,
+ *          -c sends a command line to the uart rx at the start (see debug_command),
+ *          only with UART_DEBUG_COMMANDS, e.g. built with -DUART_DEBUG_COMMANDS
+ *
+ * -i measures debug_string inserts of 1, 8, 32 and 128 bytes in bytes per us, next to the
+ * byte at a time copy with a compare-and-reset wrap that the debug buffer used before the
+ * power of two indices. Only the inserts are timed: they are done in bursts of half the
+ * event lane, and the uart, without a rate limit, empties it between the bursts.
+ * -p runs 1, 2, 4 .. producers threads that stand in for interrupts, each printing numbered
+ * lines with UART_DEBUG_BLOCK, checks that every line arrived whole and in the order of its
+ * producer, and reports the lines per second for every producer count.
+ *
+ * With -DUART_DEBUG_COMPRESS the uart bytes are coded and the lines are counted in the
+ * text expanded by tools/debug_expand, the stats build also reports the characters per byte.
+ *
+ * The time per call includes the idle polls of the main loop. For the time per byte
+ * of the producers and of the uart interrupt alone, build with the stats on:
+ *          -DUART_DEBUG_STATS '-DUART_DEBUG_CYCLES()=debug_host_cycles()'
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "uart_debug.h"
+#include "uart_debug_host.h"
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+// The debug buffer before the power of two indices: uint8_t indices, one slot kept empty
+#define BEFORE_SIZE     255
+static struct {
+    char data[BEFORE_SIZE];
+    volatile uint8_t in;
+    volatile uint8_t out;
+} before_buffer;
+
+static void before_string(const char *str) {
+    uint8_t temp_in;
+
+    while (*str != '\0') {
+        temp_in = before_buffer.in + 1;
+        if (temp_in == BEFORE_SIZE) temp_in -= BEFORE_SIZE;
+        if (temp_in == before_buffer.out) {
+            break;
+        }
+        before_buffer.data[before_buffer.in] = *str;
+        before_buffer.in++;
+        str++;
+        if (before_buffer.in == BEFORE_SIZE) before_buffer.in = 0;
+    }
+}
+
+static void wait_sent(void) {
+    while (!uart_debug_ready()) {
+        sched_yield();
+    }
+    debug_host_uart_flush();
+}
+
+// Bytes per us of the inserts alone, the time of a burst ends before the buffer is emptied
+static void bench_inserts(void) {
+    static const uint32_t sizes[] = { 1, 8, 32, 128 };
+    char message[129];
+    uint64_t t0, before_ns, after_ns, bytes;
+    uint32_t burst, i, k, s;
+
+    debug_host_uart_set_rate(0);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        memset(message, 'x', sizes[s]);
+        message[sizes[s]] = '\0';
+        burst = (UART_DEBUG_BUFFER_SIZE / 2) / sizes[s];
+        before_ns = after_ns = bytes = 0;
+        for (k = 0; k < 20000; k++) {
+            t0 = now_ns();
+            for (i = 0; i < burst; i++) {
+                before_string(message);
+            }
+            before_ns += now_ns() - t0;
+            before_buffer.out = before_buffer.in;
+
+            t0 = now_ns();
+            for (i = 0; i < burst; i++) {
+                debug_string(message);
+            }
+            after_ns += now_ns() - t0;
+            bytes += (uint64_t)burst * sizes[s];
+            wait_sent();
+        }
+        fprintf(stderr, "insert %3lu bytes: before %6.1f bytes/us, after %6.1f bytes/us\n", (unsigned long)sizes[s],
+                (double)bytes * 1000.0 / (double)before_ns, (double)bytes * 1000.0 / (double)after_ns);
+    }
+}
+
+typedef struct {
+    pthread_t thread;
+    uint32_t id;
+    uint32_t lines;
+} producer_t;
+
+static void *producer_thread(void *arg) {
+    producer_t *producer = (producer_t *)arg;
+    uint32_t i;
+
+    for (i = 0; i < producer->lines; i++) {
+        debug_printf("P%lu %lu\r\n", producer->id, i);
+    }
+    return NULL;
+}
+
+// Every line must be "P<producer> <number>" with the numbers of a producer counting up from 0
+static int check_producers(FILE *out, uint32_t count, uint32_t lines) {
+    uint32_t next[64] = { 0 };
+    unsigned long id, number, bad = 0, received = 0;
+    char line[64];
+    int end;
+
+    rewind(out);
+    while (fgets(line, sizeof(line), out) != NULL) {
+        received++;
+        end = 0;
+        if (sscanf(line, "P%lu %lu%n", &id, &number, &end) != 2 || strcmp(&line[end], "\r\n") != 0 ||
+            id >= count || number != next[id]) {
+            if (bad++ == 0) fprintf(stderr, "bad line %lu: %s", received, line);
+            continue;
+        }
+        next[id]++;
+    }
+    for (id = 0; id < count; id++) {
+        if (next[id] != lines) {
+            fprintf(stderr, "producer %lu: %lu of %lu lines\n", id, (unsigned long)next[id], (unsigned long)lines);
+            bad++;
+        }
+    }
+    return bad == 0;
+}
+
+// Producer threads against the uart interrupt of the emulated uart, without a rate limit
+static int bench_producers(uint32_t max) {
+    static producer_t producers[64];
+    uint32_t count, i, lines = 20000;
+    uint64_t t0, elapsed;
+    FILE *out;
+    int ok = 1, whole;
+
+    debug_host_uart_set_rate(0);
+    debug_set_policy(UART_DEBUG_BLOCK);
+    for (count = 1; count <= max && count <= 64; count *= 2) {
+        out = tmpfile();
+        if (out == NULL) {
+            perror("tmpfile");
+            return 0;
+        }
+        debug_host_uart_set_output(out);
+        t0 = now_ns();
+        for (i = 0; i < count; i++) {
+            producers[i].id = i;
+            producers[i].lines = lines;
+            pthread_create(&producers[i].thread, NULL, producer_thread, &producers[i]);
+        }
+        for (i = 0; i < count; i++) {
+            pthread_join(producers[i].thread, NULL);
+        }
+        wait_sent();
+        elapsed = now_ns() - t0;
+        debug_host_uart_set_output(NULL);
+        whole = check_producers(out, count, lines);
+        if (!whole) {
+            ok = 0;
+        }
+        fprintf(stderr, "%2lu producers: %lu lines, %.0f lines/s, %s\n", (unsigned long)count,
+                (unsigned long)(count * lines), (double)count * lines * 1e9 / (double)elapsed,
+                whole ? "all whole and in order" : "LINES LOST OR TORN");
+        fclose(out);
+    }
+    return ok;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: debug_bench [-t seconds] [-m ascii|binary|trace] [-r rate] [-l lines per ms] [-a alarms per s] [-o out] [-c command]...\n"
+                    "       debug_bench -i | -p producers\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    uint64_t start, end, t0, t1, busy = 0, calls = 0, next_load, next_alarm;
+    uint32_t rate = UART_DEBUG_DATA_RATE, load = 0, load_lines = 0, alarms = 0, alarm_lines = 0, i;
+    double seconds = 10.0, elapsed;
+    FILE *out = NULL;
+    debug_stats_t stats;
+    uint8_t mode = UART_DEBUG_MODE_ASCII;
+    int a, commands = 0, inserts = 0, threads = 0;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-t") == 0 && a + 1 < argc) {
+            seconds = atof(argv[++a]);
+        } else if (strcmp(argv[a], "-m") == 0 && a + 1 < argc) {
+            a++;
+            if (strcmp(argv[a], "ascii") == 0) mode = UART_DEBUG_MODE_ASCII;
+            else if (strcmp(argv[a], "binary") == 0) mode = UART_DEBUG_MODE_BINARY;
+            else if (strcmp(argv[a], "trace") == 0) mode = UART_DEBUG_MODE_TRACE;
+            else usage();
+        } else if (strcmp(argv[a], "-r") == 0 && a + 1 < argc) {
+            rate = (uint32_t)strtoul(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "-l") == 0 && a + 1 < argc) {
+            load = (uint32_t)strtoul(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "-a") == 0 && a + 1 < argc) {
+            alarms = (uint32_t)strtoul(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "-i") == 0) {
+            inserts = 1;
+        } else if (strcmp(argv[a], "-p") == 0 && a + 1 < argc) {
+            threads = atoi(argv[++a]);
+            if (threads < 1) usage();
+#ifdef UART_DEBUG_COMMANDS
+        } else if (strcmp(argv[a], "-c") == 0 && a + 1 < argc) {
+            a++;
+            commands++;
+#endif
+        } else if (strcmp(argv[a], "-o") == 0 && a + 1 < argc) {
+            out = fopen(argv[++a], "wb");
+            if (out == NULL) {
+                perror(argv[a]);
+                return 1;
+            }
+        } else {
+            usage();
+        }
+    }
+
+    debug_host_uart_set_output(out);
+    debug_uart_init();
+    debug_host_uart_set_rate(rate);
+    debug_set_mode(mode);
+    if (inserts || threads) {
+        a = 0;
+        if (inserts) {
+            bench_inserts();
+        }
+        if (threads && !bench_producers((uint32_t)threads)) {
+            a = 1;
+        }
+        debug_host_uart_stop();
+        return a;
+    }
+    for (a = 1; a < argc && commands != 0; a++) {
+        if (strcmp(argv[a], "-c") == 0) {
+            debug_host_uart_receive(argv[++a]);
+            debug_host_uart_receive("\r\n");
+        } else if (argv[a][0] == '-' && argv[a][1] != '\0') {
+            a++;        // Value of another option
+        }
+    }
+
+    start = now_ns();
+    end = start + (uint64_t)(seconds * 1e9);
+    next_load = start;
+    next_alarm = start;
+    for (t0 = start; t0 < end; t0 = now_ns()) {
+        debug_process();
+        if (load != 0 && t0 >= next_load) {
+            // Synthetic load, instant messages from the main loop
+            for (i = 0; i < load; i++) {
+                debug_printf("Load %lu: %lu %lu\r\n", (uint32_t)load_lines, (uint32_t)(t0 / 1000), (uint32_t)i);
+                load_lines++;
+            }
+            next_load += 1000000;
+        }
+        if (alarms != 0 && t0 >= next_alarm) {
+            debug_printf_lane(UART_DEBUG_LANE_ALARM, "Alarm %lu\r\n", (uint32_t)alarm_lines);
+            alarm_lines++;
+            next_alarm += 1000000000ULL / alarms;
+        }
+        t1 = now_ns();
+        busy += t1 - t0;
+        calls++;
+        sched_yield();      // Let the uart thread run on a single core host
+    }
+    elapsed = (double)(now_ns() - start) / 1e9;
+    debug_host_uart_stop();
+    debug_get_stats(&stats);
+
+    fprintf(stderr, "%.1f s at %lu baud: %llu lines, %llu bytes, %.1f lines/s, %.0f bytes/s (%.0f%% of the link, 0 = unlimited)\n",
+            elapsed, (unsigned long)rate, (unsigned long long)debug_host_uart_lines(),
+            (unsigned long long)debug_host_uart_sent(), (double)debug_host_uart_lines() / elapsed,
+            (double)debug_host_uart_sent() / elapsed,
+            rate != 0 ? 100.0 * (double)debug_host_uart_sent() * 10.0 / ((double)rate * elapsed) : 0.0);
+    fprintf(stderr, "%llu main loop calls, %.0f ns per call, %.1f ns per byte sent, %lu load lines\n",
+            (unsigned long long)calls, calls ? (double)busy / (double)calls : 0.0,
+            debug_host_uart_sent() ? (double)busy / (double)debug_host_uart_sent() : 0.0,
+            (unsigned long)load_lines);
+    if (stats.bytes_queued != 0 && stats.bytes_sent != 0) {
+        fprintf(stderr, "producers %.1f ns per byte queued, uart interrupt %.1f ns per byte sent\n",
+                (double)stats.producer_cycles / (double)stats.bytes_queued,
+                (double)stats.isr_cycles / (double)stats.bytes_sent);
+        fprintf(stderr, "max bytes used: alarm %lu of %d, event %lu of %d, telemetry %lu of %d\n",
+                (unsigned long)stats.max_used[UART_DEBUG_LANE_ALARM], UART_DEBUG_ALARM_BUFFER_SIZE,
+                (unsigned long)stats.max_used[UART_DEBUG_LANE_EVENT], UART_DEBUG_BUFFER_SIZE,
+                (unsigned long)stats.max_used[UART_DEBUG_LANE_TELEMETRY], UART_DEBUG_TELEMETRY_BUFFER_SIZE);
+    }
+    if (stats.alarm_count != 0 && rate != 0) {
+        fprintf(stderr, "%lu alarms, wait %.0f us average, %.0f us max (+ up to %d characters in the uart fifo)\n",
+                (unsigned long)stats.alarm_count,
+                (double)stats.alarm_wait * 10e6 / (double)rate / (double)stats.alarm_count,
+                (double)stats.alarm_wait_max * 10e6 / (double)rate, DEBUG_HOST_FIFO_SIZE);
+    }
+#ifdef UART_DEBUG_COMPRESS
+    if (stats.bytes_sent != 0 && debug_host_uart_sent() != 0) {
+        fprintf(stderr, "compressed: %lu characters in %llu bytes, %.2f per byte, %.0f characters/s\n",
+                (unsigned long)stats.bytes_sent, (unsigned long long)debug_host_uart_sent(),
+                (double)stats.bytes_sent / (double)debug_host_uart_sent(), (double)stats.bytes_sent / elapsed);
+    }
+#endif
+    fprintf(stderr, "%lu bytes and %lu messages dropped\n",
+            (unsigned long)stats.dropped_bytes, (unsigned long)stats.dropped_messages);
+    if (out != NULL) fclose(out);
+    return 0;
+}
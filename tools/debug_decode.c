@@ -0,0 +1,255 @@
+/*
+ * debug_decode - host decoder for the binary debug uart stream
+ *
+ * Reads a capture of the debug uart (file or stdin) in UART_DEBUG_MODE_BINARY,
+ * checks every COBS frame and its CRC and prints one CSV row per record.
+ * Trace frames (UART_DEBUG_MODE_TRACE) are formatted with the dictionary in
+ * uart_debug_trace.h and copied to stderr, together with the text printed by
+ * debug_string in between the frames.
+ *
+ * Build:   cc -O2 -I.. -o debug_decode debug_decode.c ../utl.c
+ * Usage:   debug_decode [capture.bin] > records.csv
+ *          debug_decode -d > trace.dict      Writes the trace dictionary, one "id format" per line
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "utl.h"
+#include "uart_debug_record.h"
+#include "uart_debug_trace.h"
+
+#define MAX_CHUNK   1024
+
+static unsigned long frames_ok = 0;
+static unsigned long traces_ok = 0;
+static unsigned long frames_bad = 0;
+
+// Field sizes, signedness and names in record order
+#define DEBUG_RECORD_FIELD(name, size, sign)  size,
+static const uint8_t field_size[] = { DEBUG_RECORD_FIELDS };
+#undef DEBUG_RECORD_FIELD
+#define DEBUG_RECORD_FIELD(name, size, sign)  sign,
+static const uint8_t field_signed[] = { DEBUG_RECORD_FIELDS };
+#undef DEBUG_RECORD_FIELD
+#define DEBUG_RECORD_FIELD(name, size, sign)  #name,
+static const char *field_name[] = { DEBUG_RECORD_FIELDS };
+#undef DEBUG_RECORD_FIELD
+#define FIELD_COUNT (sizeof(field_size) / sizeof(field_size[0]))
+
+// Trace formats by id
+#define DEBUG_TRACE_MESSAGE(id, format)     format,
+static const char *trace_format[DEBUG_TRACE_COUNT] = { DEBUG_TRACE_MESSAGES };
+#undef DEBUG_TRACE_MESSAGE
+
+// Writes the dictionary with the control characters escaped
+static void print_dictionary(void) {
+    const char *c;
+    int id;
+
+    for (id = 0; id < DEBUG_TRACE_COUNT; id++) {
+        printf("%d ", id);
+        for (c = trace_format[id]; *c != '\0'; c++) {
+            if (*c == '\r') printf("\\r");
+            else if (*c == '\n') printf("\\n");
+            else if (*c == '\\') printf("\\\\");
+            else putchar(*c);
+        }
+        putchar('\n');
+    }
+}
+
+static void print_header(void) {
+    size_t i;
+
+    printf("seq");
+    for (i = 0; i < FIELD_COUNT; i++) {
+        printf(",%s", field_name[i]);
+    }
+    printf("\n");
+}
+
+static void print_record(uint8_t seq, const uint8_t *record) {
+    uint32_t value;
+    size_t i;
+    uint8_t b;
+
+    printf("%u", seq);
+    for (i = 0; i < FIELD_COUNT; i++) {
+        value = 0;
+        for (b = field_size[i]; b != 0; b--) {     // Little endian
+            value = (value << 8) | record[b - 1];
+        }
+        if (field_signed[i] && field_size[i] < 4 && (value & (1UL << (8 * field_size[i] - 1)))) {
+            value |= ~0UL << (8 * field_size[i]);    // Sign extend
+        }
+        if (field_signed[i]) {
+            printf(",%ld", (long)(int32_t)value);
+        } else {
+            printf(",%lu", (unsigned long)value);
+        }
+        record += field_size[i];
+    }
+    printf("\n");
+}
+
+// Text in between frames, printed as is
+static void print_text(const uint8_t *chunk, size_t len) {
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if ((chunk[i] < 0x20 || chunk[i] > 0x7E) && chunk[i] != '\r' && chunk[i] != '\n' && chunk[i] != '\t') {
+            return;     // Not text, a damaged frame
+        }
+    }
+    fwrite(chunk, 1, len, stderr);
+}
+
+// Formats a trace message the same way as utl_vsnprintf on the target
+static void print_trace(const char *fmt, const uint32_t *args, uint8_t count) {
+    char spec[16], num[32];
+    uint8_t arg = 0;
+    size_t len, flags;
+    uint32_t value;
+
+    while (*fmt != '\0') {
+        if (*fmt != '%') {
+            fputc(*fmt++, stderr);
+            continue;
+        }
+        // Copy flags and width, drop the 'l', the host printf gets a long
+        len = 0;
+        spec[len++] = *fmt++;
+        while ((*fmt == '-' || *fmt == '0' || (*fmt >= '1' && *fmt <= '9')) && len < sizeof(spec) - 3) {
+            spec[len++] = *fmt++;
+            while (*fmt >= '0' && *fmt <= '9' && len < sizeof(spec) - 3) spec[len++] = *fmt++;
+        }
+        // A precision is a fixed point value, only utl_vsnprintf knows it
+        flags = len;
+        if (*fmt == '.') {
+            spec[len++] = *fmt++;
+            while (*fmt >= '0' && *fmt <= '9' && len < sizeof(spec) - 3) spec[len++] = *fmt++;
+        }
+        if (*fmt == 'l') fmt++;
+        if (*fmt == '\0') break;
+        value = (arg < count) ? args[arg] : 0;
+        if (len != flags && (*fmt == 'd' || *fmt == 'u')) {
+            spec[len++] = 'l'; spec[len++] = *fmt++; spec[len] = '\0';
+            utl_snprintf(num, sizeof(num), spec, value);
+            fputs(num, stderr);
+            arg++;
+            continue;
+        }
+        len = flags;
+        switch (*fmt) {
+            case 'd':
+                spec[len++] = 'l'; spec[len++] = 'd'; spec[len] = '\0';
+                fprintf(stderr, spec, (long)(int32_t)value);
+                arg++;
+                break;
+            case 'u': case 'x': case 'X':
+                spec[len++] = 'l'; spec[len++] = *fmt; spec[len] = '\0';
+                fprintf(stderr, spec, (unsigned long)value);
+                arg++;
+                break;
+            case 'c':
+                spec[len++] = 'c'; spec[len] = '\0';
+                fprintf(stderr, spec, (int)(char)value);
+                arg++;
+                break;
+            case '%':
+                fputc('%', stderr);
+                break;
+            default:
+                fputc('%', stderr);
+                fputc(*fmt, stderr);
+                break;
+        }
+        fmt++;
+    }
+}
+
+// Decodes the LEB128 arguments of a trace frame, returns 0 on a bad frame
+static int decode_trace(const uint8_t *frame, uint16_t size) {
+    uint32_t args[DEBUG_TRACE_MAX_ARGS];
+    uint8_t count = 0, shift = 0;
+    uint16_t i;
+
+    if (frame[1] >= DEBUG_TRACE_COUNT) {
+        return 0;
+    }
+    args[0] = 0;
+    for (i = DEBUG_FRAME_HEADER_SIZE; i < size; i++) {
+        if (count >= DEBUG_TRACE_MAX_ARGS || shift > 28) {
+            return 0;
+        }
+        args[count] |= (uint32_t)(frame[i] & 0x7F) << shift;
+        shift += 7;
+        if ((frame[i] & 0x80) == 0) {
+            count++;
+            shift = 0;
+            if (count < DEBUG_TRACE_MAX_ARGS) args[count] = 0;
+        }
+    }
+    if (shift != 0) {
+        return 0;           // Last argument is not complete
+    }
+    print_trace(trace_format[frame[1]], args, count);
+    return 1;
+}
+
+static void decode_chunk(const uint8_t *chunk, size_t len) {
+    uint8_t frame[MAX_CHUNK];
+    uint16_t size;
+
+    if (len == 0) {
+        return;
+    }
+    size = utl_cobs_decode(chunk, (uint16_t)len, frame);
+    if (size != UTL_COBS_ERROR && size >= DEBUG_FRAME_HEADER_SIZE + DEBUG_FRAME_CRC_SIZE &&
+        frame[0] == DEBUG_FRAME_TYPE_TRACE &&
+        utl_calc_crc(frame, size - DEBUG_FRAME_CRC_SIZE) ==
+            (uint16_t)(frame[size - 2] | (frame[size - 1] << 8)) &&
+        decode_trace(frame, size - DEBUG_FRAME_CRC_SIZE)) {
+        traces_ok++;
+        return;
+    }
+    if (size == DEBUG_FRAME_SIZE && frame[0] == DEBUG_FRAME_TYPE_RECORD &&
+        utl_calc_crc(frame, size - DEBUG_FRAME_CRC_SIZE) ==
+            (uint16_t)(frame[size - 2] | (frame[size - 1] << 8))) {
+        print_record(frame[1], &frame[DEBUG_FRAME_HEADER_SIZE]);
+        frames_ok++;
+        return;
+    }
+    print_text(chunk, len);
+    frames_bad++;
+}
+
+int main(int argc, char **argv) {
+    static uint8_t chunk[MAX_CHUNK];
+    FILE *in;
+    size_t len;
+    int c;
+
+    if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+        print_dictionary();
+        return 0;
+    }
+    in = (argc > 1) ? fopen(argv[1], "rb") : stdin;
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    print_header();
+    len = 0;
+    while ((c = getc(in)) != EOF) {
+        if (c == 0x00) {                // Frame delimiter
+            decode_chunk(chunk, len);
+            len = 0;
+        } else if (len < MAX_CHUNK) {
+            chunk[len++] = (uint8_t)c;
+        }
+    }
+    decode_chunk(chunk, len);
+    fprintf(stderr, "%lu records, %lu traces, %lu other chunks\n", frames_ok, traces_ok, frames_bad);
+    return 0;
+}
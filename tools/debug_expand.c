@@ -0,0 +1,192 @@
+/*
+ * debug_expand - host decompressor for the debug uart stream
+ *
+ * Reads a capture of the debug uart (file or stdin) made with UART_DEBUG_COMPRESS
+ * and writes the text as the firmware printed it. The codes are described in
+ * uart_debug_compress.h, the dictionary is built from uart_debug_trace.h like
+ * debug_compress_init does in the firmware, so both must come from the same tree.
+ * The output can be piped into debug_decode for the binary and trace modes.
+ * Bytes before the first sync are skipped, so the capture can start anywhere.
+ *
+ * Build:   cc -O2 -I.. -o debug_expand debug_expand.c
+ * Usage:   debug_expand [capture.bin] > capture.txt
+ *          debug_expand -d                   Writes the dictionary, one "code text" per line
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "uart_debug_trace.h"
+#include "uart_debug_compress.h"
+
+// The sync as the last four bytes read
+#define SYNC_PATTERN    (((uint32_t)DEBUG_COMPRESS_ESCAPE << 24) | ((uint32_t)DEBUG_COMPRESS_ESCAPE << 8))
+
+// Trace formats by id
+#define DEBUG_TRACE_MESSAGE(id, format)     format,
+static const char *trace_format[DEBUG_TRACE_COUNT] = { DEBUG_TRACE_MESSAGES };
+#undef DEBUG_TRACE_MESSAGE
+
+static const char *word_text[DEBUG_COMPRESS_DICT_SIZE];
+static uint8_t word_length[DEBUG_COMPRESS_DICT_SIZE];
+static int word_count = 0;
+
+static char window[DEBUG_COMPRESS_WINDOW_SIZE];
+static uint8_t position = 0;
+
+// The literal parts of the formats, with the same rules as debug_compress_init
+static void build_dictionary(void) {
+    const char *text, *part;
+    int id, length, word;
+
+    for (id = 0; id < DEBUG_TRACE_COUNT; id++) {
+        text = trace_format[id];
+        while (*text != '\0') {
+            part = text;
+            while (*text != '\0' && *text != '%') {
+                text++;
+            }
+            length = (text - part > DEBUG_COMPRESS_MATCH_MAX) ? DEBUG_COMPRESS_MATCH_MAX : (int)(text - part);
+            if (*text == '%') {
+                text++;
+                while (*text != '\0' && *text != '%' &&
+                       (*text == 'l' || !((*text >= 'a' && *text <= 'z') || (*text >= 'A' && *text <= 'Z')))) {
+                    text++;
+                }
+                if (*text != '\0') {
+                    text++;
+                }
+            }
+            if (length < 2 || word_count == DEBUG_COMPRESS_DICT_SIZE) {
+                continue;
+            }
+            for (word = 0; word < word_count; word++) {
+                if (word_length[word] == length && memcmp(word_text[word], part, length) == 0) {
+                    break;
+                }
+            }
+            if (word == word_count) {
+                word_text[word] = part;
+                word_length[word] = (uint8_t)length;
+                word_count++;
+            }
+        }
+    }
+}
+
+// Writes the dictionary with the control characters escaped
+static void print_dictionary(void) {
+    int word, i;
+
+    for (word = 0; word < word_count; word++) {
+        printf("0x%02X ", DEBUG_COMPRESS_DICT + word);
+        for (i = 0; i < word_length[word]; i++) {
+            if (word_text[word][i] == '\r') printf("\\r");
+            else if (word_text[word][i] == '\n') printf("\\n");
+            else if (word_text[word][i] == '\\') printf("\\\\");
+            else putchar(word_text[word][i]);
+        }
+        putchar('\n');
+    }
+}
+
+static void put(char c) {
+    window[position++] = c;
+    putchar(c);
+}
+
+// The window starts over at a sync, like debug_compress_sync
+static void restart(void) {
+    memset(window, 0, sizeof(window));
+    position = 0;
+}
+
+int main(int argc, char **argv) {
+    static const char digits[] = DEBUG_COMPRESS_DIGITS;
+    unsigned long in_bytes = 0, out_chars = 0, bad = 0, skipped = 0, hunted = 0, syncs = 0;
+    uint32_t last = 0;
+    FILE *in;
+    uint8_t from;
+    int c, n, i, b = 0, synced = 0;
+
+    build_dictionary();
+    if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+        print_dictionary();
+        return 0;
+    }
+    in = (argc > 1) ? fopen(argv[1], "rb") : stdin;
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    while ((c = getc(in)) != EOF) {
+        in_bytes++;
+        if (!synced) {
+            // The codes only make sense from a sync on
+            last = (last << 8) | (uint32_t)c;
+            hunted++;
+            if (last == SYNC_PATTERN) {
+                skipped += hunted - DEBUG_COMPRESS_SYNC_LENGTH;
+                syncs++;
+                synced = 1;
+                restart();
+            }
+            continue;
+        }
+        if (c < DEBUG_COMPRESS_DICT) {
+            put((char)c);
+            out_chars++;
+        } else if (c < DEBUG_COMPRESS_COPY) {
+            if (c - DEBUG_COMPRESS_DICT >= word_count) {
+                bad++;          // Not in this dictionary, the firmware has other trace formats
+                continue;
+            }
+            for (i = 0; i < word_length[c - DEBUG_COMPRESS_DICT]; i++) {
+                put(word_text[c - DEBUG_COMPRESS_DICT][i]);
+            }
+            out_chars += (unsigned long)i;
+        } else if (c < DEBUG_COMPRESS_RUN) {
+            if ((b = getc(in)) == EOF) {
+                break;
+            }
+            in_bytes++;
+            n = c - DEBUG_COMPRESS_COPY + DEBUG_COMPRESS_COPY_MIN;
+            from = (uint8_t)(position - b);
+            for (i = 0; i < n; i++) {
+                put(window[(uint8_t)(from + i)]);
+            }
+            out_chars += (unsigned long)n;
+        } else if (c < DEBUG_COMPRESS_ESCAPE) {
+            n = c - DEBUG_COMPRESS_RUN + DEBUG_COMPRESS_RUN_MIN;
+            for (i = 0; i < n; i++) {
+                if ((i & 1) == 0) {
+                    if ((b = getc(in)) == EOF) {
+                        break;
+                    }
+                    in_bytes++;
+                }
+                put(digits[((i & 1) == 0) ? (b >> 4) : (b & 0x0F)]);
+            }
+            out_chars += (unsigned long)i;
+        } else {
+            if ((b = getc(in)) == EOF) {
+                break;
+            }
+            in_bytes++;
+            if (b >= 0x80) {
+                put((char)b);
+                out_chars++;
+            } else {
+                // A sync, or a byte was lost: look for the sync from here
+                last = ((uint32_t)c << 8) | (uint32_t)b;
+                hunted = 2;
+                synced = 0;
+            }
+        }
+    }
+    if (!synced) {
+        skipped += hunted;
+    }
+    fprintf(stderr, "%lu bytes in, %lu characters out (%.2f per byte), %lu syncs, %lu bytes skipped, %lu unknown codes\n",
+            in_bytes, out_chars, in_bytes ? (double)out_chars / (double)in_bytes : 0.0, syncs, skipped, bad);
+    return 0;
+}
@@ -0,0 +1,528 @@
+/*
+ * debug_ingest - parallel ingest of long text captures of the debug uart
+ *
+ * Memory maps a capture of the lines printed by debug_process and rebuilds one
+ * row per snapshot (the block of lines that starts with the ECU state line every
+ * second). Lines that are sent faster, like the alarms, are printed several times
+ * in a snapshot, the row keeps the last value. The file is cut
+ * into chunks at snapshot boundaries and the chunks are parsed by all cores.
+ * Lines that do not match any message of the trace dictionary (uart_debug_trace.h)
+ * or the ECU state line are counted and skipped.
+ *
+ * Output is CSV, or a columnar binary file:
+ *      header  "DBGC" | version u32 | columns u32 | column names, each null terminated
+ *      blocks  rows u32 | column 0 (rows x u32) | column 1 (rows x u32) | ...
+ * All numbers are little endian, a value that is missing in a snapshot is 0xFFFFFFFF
+ * in the binary file and empty in the CSV file.
+ *
+ * Lines of UART_DEBUG_TIMESTAMPS start with the time of their snapshot, "YYYY-MM-DD hh:mm:ss ".
+ * The time of the first such line in a snapshot is the row time, in seconds since 1970 as the
+ * RTC keeps it. Rows without a time are timestamped as start + snapshot number * period.
+ * With -k a value that is missing in a snapshot is filled with the last value seen before,
+ * for captures of UART_DEBUG_DELTA_MESSAGES where unchanged lines are not sent.
+ *
+ * Build:   cc -O2 -pthread -I.. -o debug_ingest debug_ingest.c ../utl.c
+ * Usage:   debug_ingest [-f csv|bin] [-o out] [-j threads] [-t start] [-p period] [-k] capture.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "utl.h"
+#include "uart_debug_trace.h"
+
+#define MISSING         0xFFFFFFFFUL
+#define CHUNK_SIZE      (64UL << 20)    // Bytes parsed by one thread per round
+#define MAX_THREADS     64
+#define MAX_COLUMNS     128
+#define COL_TIME        0
+#define COL_ECU_STATE   1
+#define COL_ECU_MODE    2
+#define COL_TRACE       3               // First column of the trace messages
+
+// Words of the ECU state line, in the order of debug_process
+static const char *ecu_state_name[] = {
+    "OFF", "IDLE", "PUMP", "GLOW", "START", "START_DELAY", "PRERUNNING", "RUNNING", "STOPPING", "ALARM"
+};
+static const char *ecu_mode_name[] = { "LOCAL_ONLY", "MANUAL", "AUTOMATIC" };
+#define ECU_STATES  (sizeof(ecu_state_name) / sizeof(ecu_state_name[0]))
+#define ECU_MODES   (sizeof(ecu_mode_name) / sizeof(ecu_mode_name[0]))
+
+#define DEBUG_TRACE_MESSAGE(id, format)     format,
+static const char *trace_format[DEBUG_TRACE_COUNT] = { DEBUG_TRACE_MESSAGES };
+#undef DEBUG_TRACE_MESSAGE
+#define DEBUG_TRACE_MESSAGE(id, format)     #id,
+static const char *trace_name[DEBUG_TRACE_COUNT] = { DEBUG_TRACE_MESSAGES };
+#undef DEBUG_TRACE_MESSAGE
+
+static uint8_t trace_column[DEBUG_TRACE_COUNT];     // First column of every message
+static uint8_t trace_args[DEBUG_TRACE_COUNT];
+static char column_name[MAX_COLUMNS][48];
+static uint8_t columns;
+
+// Work of one thread in one round
+typedef struct {
+    const char *start;
+    const char *end;
+    uint32_t *rows;         // rows x columns values
+    size_t row_count;
+    size_t row_size;        // Allocated rows
+    unsigned long lines;
+    unsigned long skipped;
+    uint32_t first_row;     // Snapshot number of the first row
+    char *out;              // Formatted output
+    size_t out_len;
+    size_t out_size;
+} job_t;
+
+static enum { OUT_CSV, OUT_BIN } out_format = OUT_CSV;
+static uint32_t time_start = 0;
+static uint32_t time_period = 1;
+static int keep_values = 0;
+
+
+// Builds the column list from the trace dictionary
+static void init_columns(void) {
+    const char *c;
+    uint8_t id, arg;
+    char *name;
+
+    strcpy(column_name[COL_TIME], "time");
+    strcpy(column_name[COL_ECU_STATE], "ecu_state");
+    strcpy(column_name[COL_ECU_MODE], "ecu_mode");
+    columns = COL_TRACE;
+    for (id = 0; id < DEBUG_TRACE_COUNT; id++) {
+        trace_column[id] = columns;
+        trace_args[id] = 0;
+        for (c = trace_format[id]; *c != '\0'; c++) {
+            if (c[0] == '%' && c[1] != '%') trace_args[id]++;
+            else if (c[0] == '%') c++;
+        }
+        for (arg = 0; arg < trace_args[id] && columns < MAX_COLUMNS; arg++) {
+            name = column_name[columns++];
+            snprintf(name, sizeof(column_name[0]), "%s_%u",
+                     strncmp(trace_name[id], "TRACE_", 6) == 0 ? trace_name[id] + 6 : trace_name[id], arg + 1);
+            for (; *name != '\0'; name++) *name = (char)tolower((unsigned char)*name);
+        }
+    }
+}
+
+// Parses one number of a %lu, %ld or %lx conversion, single is set for
+// conversions that are directly followed by another one and have one digit.
+// A fixed point number (%.1lu) must have exactly decimals digits after the
+// point, the value is the raw integer again.
+static const char *parse_number(const char *p, const char *end, char conv, int single, int decimals, uint32_t *value) {
+    uint64_t v = 0;
+    int negative = 0, digits = 0, point = -1, d;
+
+    if (conv == 'd' && p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    while (p < end && (!single || digits == 0)) {
+        if (*p == '.' && decimals != 0 && point < 0 && digits != 0) {
+            point = digits;
+            p++;
+            continue;
+        }
+        if (*p >= '0' && *p <= '9') d = *p - '0';
+        else if ((conv == 'x' || conv == 'X') && *p >= 'a' && *p <= 'f') d = *p - 'a' + 10;
+        else if ((conv == 'x' || conv == 'X') && *p >= 'A' && *p <= 'F') d = *p - 'A' + 10;
+        else break;
+        v = v * ((conv == 'x' || conv == 'X') ? 16 : 10) + (uint64_t)d;
+        if (v > 0xFFFFFFFFULL) return NULL;
+        digits++;
+        p++;
+    }
+    if (digits == 0) return NULL;
+    if (decimals != 0 && (point < 0 || digits - point != decimals)) return NULL;
+    *value = negative ? (uint32_t)(0 - v) : (uint32_t)v;
+    return p;
+}
+
+// Matches a line against a format of the dictionary, values receives the arguments
+static int match_format(const char *p, const char *end, const char *fmt, uint32_t *values) {
+    char conv;
+    int decimals;
+
+    while (*fmt != '\0' && *fmt != '\r' && *fmt != '\n') {
+        if (fmt[0] == '%' && fmt[1] != '%') {
+            fmt++;
+            decimals = 0;
+            while (*fmt == '-' || *fmt == '0' || (*fmt >= '1' && *fmt <= '9')) fmt++;
+            if (*fmt == '.') {
+                for (fmt++; *fmt >= '0' && *fmt <= '9'; fmt++) decimals = decimals * 10 + (*fmt - '0');
+            }
+            if (*fmt == 'l') fmt++;
+            conv = *fmt++;
+            p = parse_number(p, end, conv, *fmt == '%', decimals, values++);
+            if (p == NULL) return 0;
+        } else {
+            if (fmt[0] == '%') fmt++;
+            if (p >= end || *p != *fmt) return 0;
+            p++;
+            fmt++;
+        }
+    }
+    return p == end;
+}
+
+// Skips the "YYYY-MM-DD hh:mm:ss " of utl_datetime and a space, time receives it in
+// seconds since 1970. Returns p when the line does not start with a time.
+static const char *parse_time(const char *p, const char *end, uint32_t *time) {
+    static const char pattern[] = "0000-00-00 00:00:00 ";
+    long year, month, day, era, yoe, doy, days;
+    uint64_t seconds;
+    int i;
+
+    if ((size_t)(end - p) < sizeof(pattern) - 1) return p;
+    for (i = 0; pattern[i] != '\0'; i++) {
+        if (pattern[i] == '0' ? (p[i] < '0' || p[i] > '9') : p[i] != pattern[i]) return p;
+    }
+#define FIELD(at)   ((p[at] - '0') * 10L + (p[(at) + 1] - '0'))
+    year = FIELD(0) * 100 + FIELD(2);
+    month = FIELD(5);
+    day = FIELD(8);
+    if (month < 1 || month > 12 || day < 1 || day > 31 || FIELD(11) > 23 || FIELD(14) > 59 || FIELD(17) > 59) return p;
+    // Days since 1970-01-01 of the proleptic Gregorian calendar, the year starts in March
+    year -= (month <= 2);
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = year - era * 400;
+    doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    days = era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+    if (days < 0) return p;
+    seconds = (uint64_t)days * 86400 + (uint64_t)(FIELD(11) * 3600 + FIELD(14) * 60 + FIELD(17));
+#undef FIELD
+    if (seconds > 0xFFFFFFFEULL) return p;      // 0xFFFFFFFF is MISSING
+    *time = (uint32_t)seconds;
+    return p + sizeof(pattern) - 1;
+}
+
+static int match_word(const char *p, const char *end, const char **names, size_t count) {
+    size_t i, len;
+
+    for (i = 0; i < count; i++) {
+        len = strlen(names[i]);
+        if ((size_t)(end - p) == len && memcmp(p, names[i], len) == 0) return (int)i;
+    }
+    return -1;
+}
+
+// Matches "STATE MODE", as printed by case 0 of debug_process
+static int match_state(const char *p, const char *end, uint32_t *row) {
+    const char *space;
+    int state, mode;
+
+    space = memchr(p, ' ', (size_t)(end - p));
+    if (space == NULL) return 0;
+    state = match_word(p, space, ecu_state_name, ECU_STATES);
+    mode = match_word(space + 1, end, ecu_mode_name, ECU_MODES);
+    if (state < 0 || mode < 0) return 0;
+    row[COL_ECU_STATE] = (uint32_t)state;
+    row[COL_ECU_MODE] = (uint32_t)mode;
+    return 1;
+}
+
+static uint32_t *new_row(job_t *job) {
+    uint32_t *row;
+
+    if (job->row_count == job->row_size) {
+        job->row_size = job->row_size ? job->row_size * 2 : 4096;
+        job->rows = realloc(job->rows, job->row_size * columns * sizeof(uint32_t));
+        if (job->rows == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    row = &job->rows[job->row_count++ * columns];
+    memset(row, 0xFF, columns * sizeof(uint32_t));
+    return row;
+}
+
+// Parses all lines of a chunk into rows
+static void parse_chunk(job_t *job) {
+    uint32_t values[DEBUG_TRACE_MAX_ARGS];
+    uint32_t *row = NULL;
+    uint32_t time;
+    const char *p, *end, *nl, *text;
+    uint8_t id;
+
+    job->row_count = 0;
+    job->lines = 0;
+    job->skipped = 0;
+    for (p = job->start; p < job->end; p = nl + 1) {
+        nl = memchr(p, '\n', (size_t)(job->end - p));
+        if (nl == NULL) nl = job->end;
+        end = nl;
+        if (end > p && end[-1] == '\r') end--;
+        if (end == p) {
+            row = NULL;         // Empty line ends the snapshot
+            continue;
+        }
+        job->lines++;
+        time = MISSING;
+        text = parse_time(p, end, &time);
+        if (text < end && match_state(text, end, values)) {
+            // The state line starts a new snapshot
+            row = new_row(job);
+            row[COL_TIME] = time;
+            row[COL_ECU_STATE] = values[COL_ECU_STATE];
+            row[COL_ECU_MODE] = values[COL_ECU_MODE];
+            continue;
+        }
+        for (id = 0; id < DEBUG_TRACE_COUNT; id++) {
+            if (text < end && *text == trace_format[id][0] && match_format(text, end, trace_format[id], values)) break;
+        }
+        if (id == DEBUG_TRACE_COUNT) {
+            job->skipped++;     // Corrupted or unknown line
+            continue;
+        }
+        if (row == NULL) {
+            row = new_row(job);     // The start of this snapshot was lost
+        }
+        if (row[COL_TIME] == MISSING) {
+            row[COL_TIME] = time;
+        }
+        memcpy(&row[trace_column[id]], values, trace_args[id] * sizeof(uint32_t));
+    }
+}
+
+static void out_reserve(job_t *job, size_t size) {
+    if (job->out_len + size > job->out_size) {
+        job->out_size = (job->out_len + size) * 2;
+        job->out = realloc(job->out, job->out_size);
+        if (job->out == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+}
+
+// Formats the rows of a chunk, the rows without a time need the rows of all earlier chunks
+static void format_chunk(job_t *job) {
+    uint32_t *row;
+    size_t r;
+    uint8_t c;
+    char *p;
+
+    job->out_len = 0;
+    if (out_format == OUT_CSV) {
+        for (r = 0; r < job->row_count; r++) {
+            out_reserve(job, (size_t)columns * 11 + 1);
+            row = &job->rows[r * columns];
+            if (row[COL_TIME] == MISSING) row[COL_TIME] = time_start + (job->first_row + (uint32_t)r) * time_period;
+            p = job->out + job->out_len;
+            for (c = 0; c < columns; c++) {
+                if (row[c] != MISSING) p = utl_ui32toa_dec(row[c], p);
+                *p++ = (c + 1 < columns) ? ',' : '\n';
+            }
+            job->out_len = (size_t)(p - job->out);
+        }
+    } else if (job->row_count != 0) {
+        // One block, column after column
+        out_reserve(job, 4 + job->row_count * columns * 4);
+        p = job->out;
+        memcpy(p, &(uint32_t){ (uint32_t)job->row_count }, 4);
+        p += 4;
+        for (c = 0; c < columns; c++) {
+            for (r = 0; r < job->row_count; r++) {
+                row = &job->rows[r * columns];
+                if (c == COL_TIME && row[COL_TIME] == MISSING) {
+                    row[COL_TIME] = time_start + (job->first_row + (uint32_t)r) * time_period;
+                }
+                memcpy(p, &row[c], 4);      // The host is little endian
+                p += 4;
+            }
+        }
+        job->out_len = (size_t)(p - job->out);
+    }
+}
+
+// Fills missing values with the last value seen, the chunks must be passed in order
+static void fill_chunk(job_t *job) {
+    static uint32_t last[MAX_COLUMNS];
+    static int started = 0;
+    uint32_t *row;
+    size_t r;
+    uint8_t c;
+
+    if (!started) {
+        memset(last, 0xFF, sizeof(last));
+        started = 1;
+    }
+    for (r = 0; r < job->row_count; r++) {
+        row = &job->rows[r * columns];
+        for (c = COL_ECU_STATE; c < columns; c++) {
+            if (row[c] == MISSING) row[c] = last[c];
+            else last[c] = row[c];
+        }
+    }
+}
+
+static void *parse_thread(void *arg) {
+    parse_chunk(arg);
+    return NULL;
+}
+
+static void *format_thread(void *arg) {
+    format_chunk(arg);
+    return NULL;
+}
+
+// Runs fn on all jobs in parallel
+static void run_jobs(job_t *job, int count, void *(*fn)(void *)) {
+    pthread_t thread[MAX_THREADS];
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (pthread_create(&thread[i], NULL, fn, &job[i]) != 0) {
+            fn(&job[i]);
+            thread[i] = 0;
+        }
+    }
+    for (i = 0; i < count; i++) {
+        if (thread[i] != 0) pthread_join(thread[i], NULL);
+    }
+}
+
+// Moves a chunk boundary to the start of the next snapshot, the line after an empty line
+static const char *snapshot_boundary(const char *p, const char *end) {
+    const char *nl;
+
+    while (p < end) {
+        nl = memchr(p, '\n', (size_t)(end - p));
+        if (nl == NULL) return end;
+        p = nl + 1;
+        if (p < end && *p == '\n') return p + 1;
+        if (p + 1 < end && p[0] == '\r' && p[1] == '\n') return p + 2;
+    }
+    return end;
+}
+
+static void write_header(FILE *out) {
+    uint32_t header[3] = { 0x43474244UL, 1, 0 };  // "DBGC", version 1
+    uint8_t c;
+
+    if (out_format == OUT_CSV) {
+        for (c = 0; c < columns; c++) {
+            fprintf(out, "%s%c", column_name[c], (c + 1 < columns) ? ',' : '\n');
+        }
+    } else {
+        header[2] = columns;
+        fwrite(header, sizeof(header), 1, out);
+        for (c = 0; c < columns; c++) {
+            fwrite(column_name[c], strlen(column_name[c]) + 1, 1, out);
+        }
+    }
+}
+
+static double now(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: debug_ingest [-f csv|bin] [-o out] [-j threads] [-t start] [-p period] [-k] capture.txt\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    static job_t job[MAX_THREADS];
+    const char *path = NULL, *out_path = NULL, *data, *p, *end;
+    unsigned long lines = 0, skipped = 0;
+    uint32_t rows = 0;
+    int threads, count, i, fd;
+    struct stat st;
+    double t0, t;
+    FILE *out;
+
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) out_format = OUT_CSV;
+            else if (strcmp(argv[i], "bin") == 0) out_format = OUT_BIN;
+            else usage();
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            time_start = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            time_period = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-k") == 0) {
+            keep_values = 1;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (path == NULL) usage();
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        return 1;
+    }
+    data = "";
+    if (st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        madvise((void *)data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    }
+    out = (out_path != NULL) ? fopen(out_path, "wb") : stdout;
+    if (out == NULL) {
+        perror(out_path);
+        return 1;
+    }
+
+    init_columns();
+    write_header(out);
+    t0 = now();
+    end = data + st.st_size;
+    p = data;
+    while (p < end) {
+        // One round: a chunk per thread, cut at snapshot boundaries
+        for (count = 0; count < threads && p < end; count++) {
+            job[count].start = p;
+            p = ((size_t)(end - p) > CHUNK_SIZE) ? snapshot_boundary(p + CHUNK_SIZE, end) : end;
+            job[count].end = p;
+        }
+        run_jobs(job, count, parse_thread);
+        for (i = 0; i < count; i++) {
+            job[i].first_row = rows;
+            rows += (uint32_t)job[i].row_count;
+            lines += job[i].lines;
+            skipped += job[i].skipped;
+            if (keep_values) fill_chunk(&job[i]);
+        }
+        run_jobs(job, count, format_thread);
+        for (i = 0; i < count; i++) {
+            fwrite(job[i].out, 1, job[i].out_len, out);
+        }
+    }
+    if (out != stdout) fclose(out);
+    else fflush(out);
+    t = now() - t0;
+
+    fprintf(stderr, "%lld bytes, %lu lines, %lu skipped, %lu rows in %.3f s, %.2f GB/s with %d threads\n",
+            (long long)st.st_size, lines, skipped, (unsigned long)rows, t,
+            t > 0 ? (double)st.st_size / t / 1e9 : 0.0, threads);
+    return 0;
+}
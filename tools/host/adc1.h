@@ -0,0 +1,13 @@
+#ifndef ADC1_H
+#define ADC1_H
+
+// Host stand-in of the adc getters used by uart_debug.c
+
+#include <stdint.h>
+
+enum { ADC1_RESULT_USER_SENSOR, ADC1_RESULT_BATT_SENSE };
+
+uint16_t get_adc1_raw_value(uint8_t result);
+
+
+#endif
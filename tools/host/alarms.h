@@ -0,0 +1,24 @@
+#ifndef ALARMS_H
+#define ALARMS_H
+
+// Host stand-in of the alarm getters used by uart_debug.c
+
+#include <stdint.h>
+
+enum {
+    ALARM_SENSOR_DIGITAL_1, ALARM_SENSOR_DIGITAL_2, ALARM_SENSOR_DIGITAL_3, ALARM_SENSOR_DIGITAL_4,
+    ALARM_SENSOR_ANALOG_1, ALARM_SENSOR_ANALOG_2,
+    ALARM_GENERATOR_LOW_VOLTAGE_1, ALARM_GENERATOR_LOW_VOLTAGE_2, ALARM_GENERATOR_HIGH_VOLTAGE_1,
+    ALARM_GENERATOR_HIGH_VOLTAGE_2, ALARM_GENERATOR_HIGH_CURRENT_1, ALARM_GENERATOR_HIGH_CURRENT_2,
+    ALARM_GENERATOR_HIGH_POWER_1, ALARM_GENERATOR_HIGH_POWER_2,
+    ALARM_BATTERY_LOW_VOLTAGE, ALARM_BATTERY_FAILED_TO_CHARGE,
+    ALARM_ENGINE_LOW_RPM_1, ALARM_ENGINE_LOW_RPM_2, ALARM_ENGINE_HIGH_RPM_1, ALARM_ENGINE_HIGH_RPM_2,
+    ALARM_GENERIC_FAILED_TO_START, ALARM_GENERIC_FAILED_TO_STOP, ALARM_GENERIC_E_STOP,
+    ALARM_GENERIC_MAINTENANCE, ALARM_GENERIC_USER_DIG_1, ALARM_GENERIC_USER_DIG_2, ALARM_GENERIC_USER_AN,
+    ALARM_COUNT
+};
+
+uint8_t get_alarms_state(uint8_t alarm);
+
+
+#endif
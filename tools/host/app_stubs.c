@@ -0,0 +1,183 @@
+/*
+ * Host stand-ins of the firmware getters used by uart_debug.c
+ *
+ * The values follow a simple synthetic load on the monotonic clock: generator
+ * values with noise, a slowly falling battery and alarms that toggle now and then,
+ * so the ascii, binary, trace and delta outputs all have something to send.
+ */
+#include <stdint.h>
+#include <time.h>
+#include "softwaretimer.h"
+#include "enginecontrol.h"
+#include "sensor.h"
+#include "alarms.h"
+#include "userinterface.h"
+#include "generatormeasure.h"
+#include "rtcc.h"
+#include "userio.h"
+#include "adc1.h"
+#include "sensorpiccom.h"
+
+#define MAX_TIMERS  16
+
+static struct {
+    uint32_t period;
+    uint32_t next;
+    uint8_t mode;
+    uint8_t started;
+} timers[MAX_TIMERS];
+static uint8_t timer_count = 0;
+
+
+static uint32_t now_ms(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)t.tv_sec * 1000 + (uint32_t)(t.tv_nsec / 1000000);
+}
+
+// Noise in -range..range, from a small linear congruential generator
+static int32_t noise(int32_t range) {
+    static uint32_t seed = 12345;
+
+    seed = seed * 1103515245UL + 12345;
+    return (int32_t)((seed >> 16) % (uint32_t)(2 * range + 1)) - range;
+}
+
+uint8_t software_timer_create(uint8_t mode, uint32_t period_ms) {
+    if (timer_count == MAX_TIMERS) {
+        return SOFTWARE_TIMER_NO_TIMER;
+    }
+    timers[timer_count].period = period_ms;
+    timers[timer_count].mode = mode;
+    timers[timer_count].started = 0;
+    return timer_count++;
+}
+
+void software_timer_start(uint8_t timer) {
+    if (timer < timer_count) {
+        timers[timer].next = now_ms() + timers[timer].period;
+        timers[timer].started = 1;
+    }
+}
+
+uint8_t get_software_timer_is_expired(uint8_t timer) {
+    if (timer >= timer_count || !timers[timer].started || (int32_t)(now_ms() - timers[timer].next) < 0) {
+        return SOFTWARE_TIMER_FALSE;
+    }
+    if (timers[timer].mode == SOFTWARE_TIMER_MODE_CONTINUOUS) {
+        timers[timer].next += timers[timer].period;
+    } else {
+        timers[timer].started = 0;
+    }
+    return SOFTWARE_TIMER_TRUE;
+}
+
+uint8_t get_ecu_state(void) {
+    return RUNNING;
+}
+
+uint8_t get_ecu_mode(void) {
+    return AUTOMATIC;
+}
+
+uint8_t get_sensor_digital_is_closed(uint8_t sensor) {
+    return sensor & 1;
+}
+
+uint8_t get_sensor_digital_is_activated(uint8_t sensor) {
+    return ((now_ms() / 60000) % 4) == sensor;
+}
+
+uint8_t get_sensor_alt_feedback_is_activated(void) {
+    return 1;
+}
+
+uint8_t get_sensor_e_stop_is_closed(void) {
+    return 1;
+}
+
+uint8_t get_sensor_e_stop_is_activated(void) {
+    return 0;
+}
+
+uint16_t get_sensor_battery_voltage_mv(void) {
+    return (uint16_t)(13200 - (now_ms() / 1000) % 1000 + noise(20));
+}
+
+uint8_t get_alarms_state(uint8_t alarm) {
+    // Every alarm is active for 5 s out of 40 s, each at its own time
+    return ((now_ms() / 1000 + alarm * 7) % 40) < 5;
+}
+
+uint8_t get_user_interface_button_state(uint8_t button, uint8_t state) {
+    return (button == BUTTON_LOCAL_ROM_MODE) == (state == BUTTON_DOWN);
+}
+
+uint16_t get_generator_measure_voltage_100mv(uint8_t phase) {
+    return (uint16_t)(2300 + phase + noise(8));
+}
+
+uint16_t get_generator_measure_current_100ma(uint8_t phase) {
+    return (uint16_t)(120 + 10 * phase + noise(3));
+}
+
+uint32_t get_generator_measure_phase_power_va(uint8_t phase) {
+    return (uint32_t)get_generator_measure_voltage_100mv(phase) * get_generator_measure_current_100ma(phase) / 100;
+}
+
+uint32_t get_generator_measure_total_power_va(void) {
+    return get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_1) +
+           get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_2) +
+           get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_3);
+}
+
+uint16_t get_generator_measure_voltage_freq_10mhz(void) {
+    return (uint16_t)(5000 + noise(4));
+}
+
+uint16_t get_generator_measure_rpm(void) {
+    return (uint16_t)(1500 + noise(6));
+}
+
+int16_t get_generator_measure_temperature_100mdeg(uint8_t sensor) {
+    return (int16_t)(650 + 25 * sensor + noise(2));
+}
+
+rtcc_timestamp_t get_rtcc_timestamp(void) {
+    rtcc_timestamp_t timestamp;
+    time_t now = time(NULL);
+    struct tm *t = gmtime(&now);
+
+    timestamp.year = (uint8_t)(t->tm_year - 100);
+    timestamp.month = (uint8_t)(t->tm_mon + 1);
+    timestamp.day = (uint8_t)t->tm_mday;
+    timestamp.hour = (uint8_t)t->tm_hour;
+    timestamp.min = (uint8_t)t->tm_min;
+    timestamp.sec = (uint8_t)t->tm_sec;
+    return timestamp;
+}
+
+uint8_t get_rtcc_backup_battery_good(void) {
+    return 1;
+}
+
+uint16_t get_userio_analog_input_value(void) {
+    return (uint16_t)(512 + noise(2));
+}
+
+uint16_t get_adc1_raw_value(uint8_t result) {
+    return (uint16_t)((result == ADC1_RESULT_BATT_SENSE ? 3300 : 1000) + noise(3));
+}
+
+uint16_t get_sensor_pic_engine_analog_sensor_raw(uint8_t sensor) {
+    return (uint16_t)(200 + 50 * sensor + noise(2));
+}
+
+uint16_t get_sensor_pic_pt100_temperature_raw(uint8_t sensor) {
+    return (uint16_t)(1100 + sensor + noise(2));
+}
+
+uint8_t get_sensor_pic_com_state(void) {
+    return 2;
+}
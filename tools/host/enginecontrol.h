@@ -0,0 +1,15 @@
+#ifndef ENGINECONTROL_H
+#define ENGINECONTROL_H
+
+// Host stand-in of the engine control getters used by uart_debug.c
+
+#include <stdint.h>
+
+enum { OFF, IDLE, PUMPING, GLOWING, CRANKING, START_DELAY, SAFETY_ON_DELAY, RUNNING, STOPPING, ALARM };
+enum { LOCAL_ONLY, MANUAL, AUTOMATIC };
+
+uint8_t get_ecu_state(void);
+uint8_t get_ecu_mode(void);
+
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef GENERATORMEASURE_H
+#define GENERATORMEASURE_H
+
+// Host stand-in of the generator measurement getters used by uart_debug.c
+
+#include <stdint.h>
+
+enum { GENERATOR_MEASURE_PHASE_1, GENERATOR_MEASURE_PHASE_2, GENERATOR_MEASURE_PHASE_3 };
+enum { GENERATOR_MEASURE_TEMPERATURE_1, GENERATOR_MEASURE_TEMPERATURE_2, GENERATOR_MEASURE_TEMPERATURE_3 };
+
+uint16_t get_generator_measure_voltage_100mv(uint8_t phase);
+uint16_t get_generator_measure_current_100ma(uint8_t phase);
+uint32_t get_generator_measure_phase_power_va(uint8_t phase);
+uint32_t get_generator_measure_total_power_va(void);
+uint16_t get_generator_measure_voltage_freq_10mhz(void);
+uint16_t get_generator_measure_rpm(void);
+int16_t get_generator_measure_temperature_100mdeg(uint8_t sensor);
+
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef RTCC_H
+#define RTCC_H
+
+// Host stand-in of the real time clock getters used by uart_debug.c
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t year;       // Years since 2000
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+} rtcc_timestamp_t;
+
+rtcc_timestamp_t get_rtcc_timestamp(void);
+uint8_t get_rtcc_backup_battery_good(void);
+
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SENSOR_H
+#define SENSOR_H
+
+// Host stand-in of the sensor getters used by uart_debug.c
+
+#include <stdint.h>
+
+enum { SENSOR_DIGITAL_SWITCH_1, SENSOR_DIGITAL_SWITCH_2, SENSOR_DIGITAL_SWITCH_3, SENSOR_DIGITAL_SWITCH_4 };
+
+uint8_t get_sensor_digital_is_closed(uint8_t sensor);
+uint8_t get_sensor_digital_is_activated(uint8_t sensor);
+uint8_t get_sensor_alt_feedback_is_activated(void);
+uint8_t get_sensor_e_stop_is_closed(void);
+uint8_t get_sensor_e_stop_is_activated(void);
+uint16_t get_sensor_battery_voltage_mv(void);
+
+
+#endif
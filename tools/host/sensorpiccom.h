@@ -0,0 +1,15 @@
+#ifndef SENSORPICCOM_H
+#define SENSORPICCOM_H
+
+// Host stand-in of the sensor pic getters used by uart_debug.c
+
+#include <stdint.h>
+
+enum { SENSOR_PIC_COM_AN_SENSOR_1, SENSOR_PIC_COM_AN_SENSOR_2 };
+
+uint16_t get_sensor_pic_engine_analog_sensor_raw(uint8_t sensor);
+uint16_t get_sensor_pic_pt100_temperature_raw(uint8_t sensor);
+uint8_t get_sensor_pic_com_state(void);
+
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SOFTWARETIMER_H
+#define SOFTWARETIMER_H
+
+// Host stand-in of the firmware software timers, on the monotonic clock
+
+#include <stdint.h>
+
+#define SOFTWARE_TIMER_NO_TIMER         255
+#define SOFTWARE_TIMER_MODE_SINGLE      0
+#define SOFTWARE_TIMER_MODE_CONTINUOUS  1
+#define SOFTWARE_TIMER_FALSE            0
+#define SOFTWARE_TIMER_TRUE             1
+
+uint8_t software_timer_create(uint8_t mode, uint32_t period_ms);
+void software_timer_start(uint8_t timer);
+uint8_t get_software_timer_is_expired(uint8_t timer);
+
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * Emulated debug uart for host builds, see uart_debug_host.h
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "uart_debug.h"
+#include "uart_debug_host.h"
+
+#define NS_PER_S    1000000000L
+#define IDLE_NS     10000L          // Poll period of an idle uart without a data rate
+
+static struct {
+    char data[DEBUG_HOST_FIFO_SIZE];    // Transmit fifo, only used by the uart thread
+    uint8_t head;
+    uint8_t count;
+} fifo;
+static struct {
+    char data[DEBUG_HOST_FIFO_SIZE];    // Receive fifo, only used by the uart thread
+    uint8_t head;
+    uint8_t count;
+} rx_fifo;
+static struct {
+    char data[DEBUG_HOST_LINE_SIZE];    // Characters sent by debug_host_uart_receive
+    uint16_t head;
+    uint16_t count;
+} rx_line;
+static pthread_mutex_t rx_line_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint_fast8_t tx_irq = 0;
+static uint8_t rx_irq = 0;                  // Only used by the uart thread
+static atomic_uint_fast32_t char_ns = 0;    // Time of one character, 0 for no timing
+static atomic_uint_fast64_t sent = 0;
+static atomic_uint_fast64_t lines = 0;
+static atomic_int running = 0;
+static atomic_uint_fast64_t idle_loops = 0;     // Loops with an empty fifo and no interrupt pending
+static _Atomic(FILE *) output = NULL;
+static pthread_t thread;
+
+
+static void add_ns(struct timespec *t, long ns) {
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= NS_PER_S) {
+        t->tv_nsec -= NS_PER_S;
+        t->tv_sec++;
+    }
+}
+
+static int before(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+// Moves the next character of the fifo to the shift register and out of the port
+static void shift_out(void) {
+    FILE *out;
+    char c;
+
+    c = fifo.data[fifo.head];
+    fifo.head = (fifo.head + 1) % DEBUG_HOST_FIFO_SIZE;
+    fifo.count--;
+    if (fifo.count == 0) {
+        atomic_store(&tx_irq, 1);   // The transmit buffer became empty
+    }
+    out = atomic_load(&output);
+    if (out != NULL) {
+        putc(c, out);
+    }
+    atomic_fetch_add(&sent, 1);
+    if (c == '\n') {
+        atomic_fetch_add(&lines, 1);
+    }
+}
+
+#ifdef UART_DEBUG_COMMANDS
+// Moves the next received character into the receive fifo, one per character time
+static void shift_in(void) {
+    pthread_mutex_lock(&rx_line_lock);
+    if (rx_line.count != 0 && rx_fifo.count < DEBUG_HOST_FIFO_SIZE) {
+        rx_fifo.data[(rx_fifo.head + rx_fifo.count) % DEBUG_HOST_FIFO_SIZE] = rx_line.data[rx_line.head];
+        rx_fifo.count++;
+        rx_line.head = (rx_line.head + 1) % DEBUG_HOST_LINE_SIZE;
+        rx_line.count--;
+        rx_irq = 1;
+    }
+    pthread_mutex_unlock(&rx_line_lock);
+}
+#endif
+
+static void *uart_thread(void *arg) {
+    struct timespec next, now;
+    long ns;
+
+    (void)arg;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (atomic_load(&running) || fifo.count != 0) {
+        // Interrupt delivery, the routine clears the flag first
+        if (atomic_load(&tx_irq)) {
+            debug_host_tx_isr();
+        }
+#ifdef UART_DEBUG_COMMANDS
+        shift_in();
+        if (rx_irq) {
+            debug_host_rx_isr();
+        }
+#endif
+        ns = (long)atomic_load(&char_ns);
+        if (fifo.count != 0) {
+            shift_out();
+            if (ns != 0) {
+                // Absolute deadlines, so the average rate is exact even when a wake up is late
+                add_ns(&next, ns);
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+            }
+        } else {
+            if (!atomic_load(&tx_irq)) {
+                atomic_fetch_add(&idle_loops, 1);
+            }
+            // Idle line, the next character can start right away
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (before(&next, &now)) next = now;
+            add_ns(&now, ns != 0 ? ns : IDLE_NS);
+            if (!atomic_load(&tx_irq)) {
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &now, NULL);
+            }
+        }
+    }
+    return NULL;
+}
+
+void debug_host_uart_init(uint32_t data_rate) {
+    debug_host_uart_set_rate(data_rate);
+    if (!atomic_exchange(&running, 1)) {
+        pthread_create(&thread, NULL, uart_thread, NULL);
+    }
+}
+
+void debug_host_uart_set_rate(uint32_t data_rate) {
+    // 8N1, 10 bits per character
+    atomic_store(&char_ns, data_rate != 0 ? (uint_fast32_t)(10LL * NS_PER_S / data_rate) : 0);
+}
+
+void debug_host_uart_set_output(FILE *out) {
+    atomic_store(&output, out);
+}
+
+void debug_host_uart_flush(void) {
+    uint_fast64_t loops = atomic_load(&idle_loops);
+
+    // The second idle loop started after the call, with the interrupt done and the fifo empty
+    while (atomic_load(&running) && atomic_load(&idle_loops) < loops + 2) {
+        sched_yield();
+    }
+}
+
+uint8_t debug_host_tx_full(void) {
+    return fifo.count == DEBUG_HOST_FIFO_SIZE;
+}
+
+void debug_host_tx_write(char c) {
+    if (fifo.count < DEBUG_HOST_FIFO_SIZE) {
+        fifo.data[(fifo.head + fifo.count) % DEBUG_HOST_FIFO_SIZE] = c;
+        fifo.count++;
+    }
+}
+
+void debug_host_tx_irq(uint8_t flag) {
+    atomic_store(&tx_irq, flag);
+}
+
+uint8_t debug_host_rx_available(void) {
+    return rx_fifo.count != 0;
+}
+
+char debug_host_rx_read(void) {
+    char c = 0;
+
+    if (rx_fifo.count != 0) {
+        c = rx_fifo.data[rx_fifo.head];
+        rx_fifo.head = (rx_fifo.head + 1) % DEBUG_HOST_FIFO_SIZE;
+        rx_fifo.count--;
+    }
+    return c;
+}
+
+void debug_host_rx_irq(uint8_t flag) {
+    rx_irq = flag;
+}
+
+void debug_host_uart_receive(const char *str) {
+    pthread_mutex_lock(&rx_line_lock);
+    for ( ; *str != '\0' && rx_line.count < DEBUG_HOST_LINE_SIZE; str++) {
+        rx_line.data[(rx_line.head + rx_line.count) % DEBUG_HOST_LINE_SIZE] = *str;
+        rx_line.count++;
+    }
+    pthread_mutex_unlock(&rx_line_lock);
+}
+
+uint16_t debug_host_cycles(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint16_t)now.tv_nsec;
+}
+
+uint64_t debug_host_uart_sent(void) {
+    return atomic_load(&sent);
+}
+
+uint64_t debug_host_uart_lines(void) {
+    return atomic_load(&lines);
+}
+
+void debug_host_uart_stop(void) {
+    if (atomic_exchange(&running, 0)) {
+        pthread_join(thread, NULL);
+    }
+    if (atomic_load(&output) != NULL) {
+        fflush(atomic_load(&output));
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef UART_DEBUG_HOST_H
+#define UART_DEBUG_HOST_H
+
+/*
+ * Emulated debug uart for host builds, used by uart_debug_hal.h on every target
+ * that is not the dsPIC.
+ *
+ * Like UART2 it has a 4 character transmit fifo and raises the transmit interrupt
+ * when the fifo becomes empty (UTXISEL = 10). A thread shifts the characters out
+ * at the data rate, 10 bits per character, and runs the interrupt routine while
+ * the interrupt flag is set. Producers run on other threads, like code at a lower
+ * interrupt priority.
+ * Characters passed to debug_host_uart_receive arrive in a 4 character receive
+ * fifo at the same rate, and raise the receive interrupt like URXISEL = 00.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sched.h>
+
+#define DEBUG_HOST_FIFO_SIZE    4
+#define DEBUG_HOST_LINE_SIZE    256     // Characters on their way to the receive fifo
+
+#define Nop()   sched_yield()
+
+// Called by uart_debug.c through uart_debug_hal.h
+void debug_host_uart_init(uint32_t data_rate);
+uint8_t debug_host_tx_full(void);
+void debug_host_tx_write(char c);
+void debug_host_tx_irq(uint8_t flag);
+uint8_t debug_host_rx_available(void);
+char debug_host_rx_read(void);
+void debug_host_rx_irq(uint8_t flag);
+
+// Uart interrupt routines, defined in uart_debug.c
+void debug_host_tx_isr(void);
+void debug_host_rx_isr(void);
+
+/**
+ * Function prototype:  void debug_host_uart_set_rate(uint32_t data_rate)
+ * Description:         Changes the data rate, 0 sends the characters as fast as the host can
+ */
+void debug_host_uart_set_rate(uint32_t data_rate);
+
+/**
+ * Function prototype:  void debug_host_uart_set_output(FILE *out)
+ * Description:         Writes every character that is sent to out, NULL only counts them
+ */
+void debug_host_uart_set_output(FILE *out);
+
+/**
+ * Function prototype:  void debug_host_uart_flush(void)
+ * Description:         Waits till the uart interrupt has nothing to send and the fifo is empty.
+ *                      Call it after uart_debug_ready, e.g. before changing the output.
+ */
+void debug_host_uart_flush(void);
+
+/**
+ * Function prototype:  void debug_host_uart_receive(const char *str)
+ * Description:         Sends str to the receive pin of the uart, e.g. a command line.
+ *                      Characters that do not fit in the line queue are lost.
+ */
+void debug_host_uart_receive(const char *str);
+
+/**
+ * Function prototype:  uint64_t debug_host_uart_sent(void)
+ * Description:         Returns the number of characters sent since the init
+ */
+uint64_t debug_host_uart_sent(void);
+
+/**
+ * Function prototype:  uint64_t debug_host_uart_lines(void)
+ * Description:         Returns the number of '\n' characters sent since the init
+ */
+uint64_t debug_host_uart_lines(void);
+
+/**
+ * Function prototype:  uint16_t debug_host_cycles(void)
+ * Description:         Free running ns counter for the stats, build with
+ *                      -DUART_DEBUG_STATS '-DUART_DEBUG_CYCLES()=debug_host_cycles()'
+ */
+uint16_t debug_host_cycles(void);
+
+/**
+ * Function prototype:  void debug_host_uart_stop(void)
+ * Description:         Sends what is left in the fifo and stops the uart thread
+ */
+void debug_host_uart_stop(void);
+
+
+#endif
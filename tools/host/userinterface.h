@@ -0,0 +1,14 @@
+#ifndef USERINTERFACE_H
+#define USERINTERFACE_H
+
+// Host stand-in of the user interface getters used by uart_debug.c
+
+#include <stdint.h>
+
+enum { BUTTON_LOCAL_ROM_START_STOP, BUTTON_LOCAL_ROM_MODE, SWITCH_LOCAL_ROM_LOCAL, SWITCH_LOCAL_ROM_REMOTE, BUTTON_REMOTE_ROM_START_STOP };
+enum { BUTTON_UP, BUTTON_DOWN };
+
+uint8_t get_user_interface_button_state(uint8_t button, uint8_t state);
+
+
+#endif
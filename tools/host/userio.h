@@ -0,0 +1,11 @@
+#ifndef USERIO_H
+#define USERIO_H
+
+// Host stand-in of the user io getters used by uart_debug.c
+
+#include <stdint.h>
+
+uint16_t get_userio_analog_input_value(void);
+
+
+#endif
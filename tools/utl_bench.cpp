@@ -0,0 +1,648 @@
+/*
+ * utl_bench - host benchmark and reference check of the utl conversions
+ *
+ * Runs every utl integer conversion over uniform, small and worst case (max digits)
+ * inputs for every supported radix, utl_fixtoa for a few scales, utl_datetime for a
+ * ticking clock and for random times, and the crc over small, medium and large buffers.
+ * Each output is compared with a reference built with std::to_chars / strtol, and
+ * the time per call is measured next to snprintf, std::to_chars, strtol/strtoul and
+ * std::from_chars. The values are drawn from the target ranges: int and unsigned int
+ * are 16 bit, long is 32 bit on the dsPIC.
+ *
+ * The results are written as JSON, one object per function, radix and distribution,
+ * so a run can be compared with an earlier one when the kernels change. The exit
+ * status is 1 when an output differs from the reference.
+ *
+ * Build:   cc -O2 -c -o utl.o ../utl.c && c++ -O2 -std=c++17 -I.. -o utl_bench utl_bench.cpp utl.o
+ * Usage:   utl_bench [-n inputs] [-f function] [-o results.json]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <charconv>
+extern "C" {
+#include "utl.h"
+}
+
+#define MAX_INPUTS      65536
+#define STR_SIZE        80
+#define MIN_SAMPLE_NS   2000000     // Time of one sample, the best of SAMPLES is reported
+#define SAMPLES         5
+
+enum domain { DOM_S16, DOM_U16, DOM_S32, DOM_U32, DOM_S64, DOM_U64 };
+
+// How the reference writes a negative value
+enum sign { SIGN_NONE, SIGN_DEC_ONLY, SIGN_ALWAYS };
+
+enum dist { DIST_UNIFORM, DIST_SMALL, DIST_WORST, DIST_COUNT };
+static const char *dist_name[DIST_COUNT] = { "uniform", "small", "worst" };
+
+typedef void (*to_str_t)(int64_t value, char *str, uint8_t radix);
+typedef int64_t (*from_str_t)(char *str, uint8_t radix);
+
+struct to_str_case {
+    const char *name;
+    to_str_t run;
+    domain dom;
+    sign neg;               // Negative values: '-' and the magnitude, or the two's complement
+    uint8_t len;            // Zero padded length, 0 for none
+    uint8_t min_radix, max_radix;
+};
+
+struct from_str_case {
+    const char *name;
+    from_str_t run;
+    domain dom;
+    uint8_t min_radix, max_radix;
+};
+
+static void run_itoa(int64_t v, char *s, uint8_t r)     { utl_itoa((int16_t)v, s, r); }
+static void run_uitoa(int64_t v, char *s, uint8_t r)    { utl_uitoa((uint16_t)v, s, r); }
+static void run_ultoa(int64_t v, char *s, uint8_t r)    { utl_ultoa((uint32_t)v, s, r); }
+static void run_lltoa(int64_t v, char *s, uint8_t r)    { utl_lltoa((long long)v, s, r); }
+static void run_i32toa(int64_t v, char *s, uint8_t r)   { utl_i32toa((int32_t)v, s, r); }
+static void run_ui32toa(int64_t v, char *s, uint8_t r)  { utl_ui32toa((uint32_t)v, s, r); }
+static void run_itoa_l(int64_t v, char *s, uint8_t r)   { utl_itoa_l((int16_t)v, s, r, 6); }
+static void run_i32toa_l(int64_t v, char *s, uint8_t r) { utl_i32toa_l((uint32_t)v, s, r, 8); }
+static void run_u64toa(int64_t v, char *s, uint8_t r)   { (void)r; utl_u64toa((uint64_t)v, s); }
+static void run_i64toa(int64_t v, char *s, uint8_t r)   { (void)r; utl_i64toa(v, s); }
+
+// The plain loop with one 64 bit division per digit, as a baseline for utl_u64toa
+static void run_naive_u64toa(int64_t v, char *s, uint8_t r) {
+    uint64_t value = (uint64_t)v;
+    char temp[24];
+    int i = 0;
+
+    do {
+        temp[i++] = (char)('0' + value % r);
+        value /= r;
+    } while (value != 0);
+    while (i != 0) *s++ = temp[--i];
+    *s = '\0';
+}
+
+static int64_t run_atoi32(char *s, uint8_t r)           { return utl_atoi32(s, r); }
+static int64_t run_atoui32(char *s, uint8_t r)          { return utl_atoui32(s, r); }
+static int64_t run_hstoi(char *s, uint8_t r)            { (void)r; return (uint16_t)utl_hstoi(s); }
+
+static int64_t run_parse_u32(char *s, uint8_t r) {
+    uint32_t value;
+    uint8_t status;
+
+    utl_parse_u32(s, (uint16_t)strlen(s), r, &value, &status);
+    return status == UTL_PARSE_OK ? (int64_t)value : -1;
+}
+
+static int64_t run_parse_i32(char *s, uint8_t r) {
+    int32_t value;
+    uint8_t status;
+
+    utl_parse_i32(s, (uint16_t)strlen(s), r, &value, &status);
+    return status == UTL_PARSE_OK ? (int64_t)value : INT64_MIN;
+}
+
+static const to_str_case to_str_cases[] = {
+    { "utl_itoa",       run_itoa,       DOM_S16, SIGN_DEC_ONLY, 0, 2, 16 },
+    { "utl_uitoa",      run_uitoa,      DOM_U16, SIGN_NONE,     0, 2, 16 },
+    { "utl_ultoa",      run_ultoa,      DOM_U32, SIGN_NONE,     0, 2, 16 },
+    { "utl_lltoa",      run_lltoa,      DOM_S64, SIGN_DEC_ONLY, 0, 2, 16 },
+    { "utl_i32toa",     run_i32toa,     DOM_S32, SIGN_ALWAYS,   0, 2, 16 },
+    { "utl_ui32toa",    run_ui32toa,    DOM_U32, SIGN_NONE,     0, 2, 16 },
+    { "utl_itoa_l",     run_itoa_l,     DOM_S16, SIGN_DEC_ONLY, 6, 2, 16 },
+    { "utl_i32toa_l",   run_i32toa_l,   DOM_U32, SIGN_NONE,     8, 2, 16 },
+    { "utl_u64toa",     run_u64toa,     DOM_U64, SIGN_NONE,     0, 10, 10 },
+    { "utl_i64toa",     run_i64toa,     DOM_S64, SIGN_ALWAYS,   0, 10, 10 },
+    { "naive_u64toa",   run_naive_u64toa, DOM_U64, SIGN_NONE,   0, 10, 10 },
+};
+
+static const from_str_case from_str_cases[] = {
+    { "utl_atoi32",     run_atoi32,     DOM_S32, 2, 16 },
+    { "utl_atoui32",    run_atoui32,    DOM_U32, 2, 16 },
+    { "utl_hstoi",      run_hstoi,      DOM_U16, 16, 16 },
+    { "utl_parse_u32",  run_parse_u32,  DOM_U32, 2, 16 },
+    { "utl_parse_i32",  run_parse_i32,  DOM_S32, 2, 16 },
+};
+
+// Status and end pointer of the bounded parsers on the edge cases
+struct parse_case {
+    const char *str;
+    uint8_t radix;
+    int64_t value;
+    uint8_t status;
+    uint8_t end;
+};
+
+static const parse_case parse_cases[] = {
+    { "",               10, 0,              UTL_PARSE_INVALID,  0 },
+    { "-",              10, 0,              UTL_PARSE_INVALID,  0 },
+    { "x12",            10, 0,              UTL_PARSE_INVALID,  0 },
+    { "12,5",           10, 12,             UTL_PARSE_OK,       2 },
+    { "+7",             10, 7,              UTL_PARSE_OK,       2 },
+    { "19",             9,  1,              UTL_PARSE_OK,       1 },
+    { "-2147483648",    10, INT32_MIN,      UTL_PARSE_OK,       11 },
+    { "2147483648",     10, INT32_MAX,      UTL_PARSE_OVERFLOW, 10 },
+    { "-2147483649",    10, INT32_MIN,      UTL_PARSE_OVERFLOW, 11 },
+    { "000000000000000000001234", 10, 1234, UTL_PARSE_OK,       24 },
+    { "99999999999999999999", 10, INT32_MAX, UTL_PARSE_OVERFLOW, 20 },
+    { "7fffFFFF",       16, INT32_MAX,      UTL_PARSE_OK,       8 },
+    { "-80000000",      16, INT32_MIN,      UTL_PARSE_OK,       9 },
+    { "123456789abcdefg", 16, INT32_MAX,    UTL_PARSE_OVERFLOW, 15 },
+    { "1011",           2,  11,             UTL_PARSE_OK,       4 },
+};
+
+static int64_t values[MAX_INPUTS];
+static char strings[MAX_INPUTS][STR_SIZE];
+static char out[STR_SIZE];
+static volatile uint32_t sink;
+static FILE *json;
+static int results = 0;
+static unsigned long mismatches_total = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void domain_range(domain dom, int64_t *min, int64_t *max) {
+    switch (dom) {
+        // The most negative value has no magnitude in the signed type, it is left out
+        case DOM_S16: *min = -INT16_MAX; *max = INT16_MAX;  break;
+        case DOM_U16: *min = 0;          *max = UINT16_MAX; break;
+        case DOM_S32: *min = -INT32_MAX; *max = INT32_MAX;  break;
+        case DOM_S64: *min = -INT64_MAX; *max = INT64_MAX;  break;
+        default:      *min = 0;          *max = UINT32_MAX; break;
+    }
+}
+
+static int domain_signed(domain dom) {
+    return dom == DOM_S16 || dom == DOM_S32 || dom == DOM_S64;
+}
+
+// Two's complement width of a negative value in a radix without sign
+static uint64_t domain_mask(domain dom) {
+    return dom == DOM_S16 ? 0xFFFFULL : dom == DOM_S32 ? 0xFFFFFFFFULL : ~0ULL;
+}
+
+static void make_values(domain dom, dist d, int n) {
+    int64_t min, max, v;
+    uint64_t span;
+    int i;
+
+    domain_range(dom, &min, &max);
+    for (i = 0; i < n; i++) {
+        if (dom == DOM_U64 || (dom == DOM_S64 && d == DIST_UNIFORM)) {
+            // Full 64 bit range, kept as the bit pattern in values[]
+            v = (int64_t)rng();
+            if (d == DIST_SMALL) v = (int64_t)((uint64_t)v % 100);
+            if (d == DIST_WORST) v = (int64_t)(~0ULL - (uint64_t)v % (~0ULL / 16 + 1));
+            if (dom == DOM_S64 && v == INT64_MIN) v = INT64_MAX;
+            values[i] = v;
+            continue;
+        }
+        switch (d) {
+            case DIST_UNIFORM:
+                span = (uint64_t)(max - min) + 1;
+                v = min + (int64_t)(rng() % span);
+                break;
+            case DIST_SMALL:
+                v = (int64_t)(rng() % 100);
+                if (min < 0 && (rng() & 1)) v = -v;
+                break;
+            default:
+                // Top 1/16 of the range has the max number of digits in every radix
+                v = max - (int64_t)(rng() % (uint64_t)(max / 16 + 1));
+                if (min < 0 && (rng() & 1)) v = -v;
+                break;
+        }
+        values[i] = v;
+    }
+}
+
+// Digits of the magnitude in uppercase, optionally zero padded
+static char *ref_digits(uint64_t mag, char *str, uint8_t radix, uint8_t len) {
+    char digits[STR_SIZE];
+    char *end;
+    int count, i;
+
+    end = std::to_chars(digits, digits + sizeof(digits), mag, radix).ptr;
+    count = (int)(end - digits);
+    for (i = count; i < len; i++) *str++ = '0';
+    for (i = 0; i < count; i++) {
+        *str++ = (digits[i] >= 'a') ? (char)(digits[i] - 'a' + 'A') : digits[i];
+    }
+    *str = '\0';
+    return str;
+}
+
+static void ref_to_str(const to_str_case *c, int64_t v, char *str, uint8_t radix) {
+    if (!domain_signed(c->dom) || v >= 0) {
+        ref_digits((uint64_t)v, str, radix, c->len);
+    } else if (c->neg == SIGN_ALWAYS || (c->neg == SIGN_DEC_ONLY && radix == 10)) {
+        *str++ = '-';
+        ref_digits((uint64_t)(-v), str, radix, c->len);
+    } else {
+        ref_digits((uint64_t)v & domain_mask(c->dom), str, radix, c->len);
+    }
+}
+
+static double pow10_scale(uint8_t scale) {
+    double p = 1.0;
+
+    while (scale--) p *= 10.0;
+    return p;
+}
+
+// Best time per call of SAMPLES samples, each repeating the inputs for MIN_SAMPLE_NS
+template <typename F>
+static double time_ns(int n, F body) {
+    uint64_t start, elapsed;
+    double best = 0.0, per_call;
+    unsigned long calls;
+    int s, i;
+
+    for (s = 0; s < SAMPLES; s++) {
+        calls = 0;
+        start = now_ns();
+        do {
+            for (i = 0; i < n; i++) body(i);
+            calls += (unsigned long)n;
+            elapsed = now_ns() - start;
+        } while (elapsed < MIN_SAMPLE_NS);
+        per_call = (double)elapsed / (double)calls;
+        if (s == 0 || per_call < best) best = per_call;
+    }
+    return best;
+}
+
+static void json_ns(const char *key, double ns) {
+    if (ns < 0.0) fprintf(json, ", \"%s\": null", key);
+    else fprintf(json, ", \"%s\": %.2f", key, ns);
+}
+
+static void json_result(const char *name, int radix, const char *dist, int n, double utl_ns,
+                        double snprintf_ns, double std_ns, const char *std_key, double strto_ns,
+                        unsigned long mismatches, const char *input, const char *expected, const char *got) {
+    fprintf(json, "%s\n    {\"function\": \"%s\", \"radix\": %d, \"distribution\": \"%s\", \"inputs\": %d",
+            results++ ? "," : "", name, radix, dist, n);
+    json_ns("utl_ns", utl_ns);
+    json_ns("snprintf_ns", snprintf_ns);
+    json_ns(std_key, std_ns);
+    json_ns("strto_ns", strto_ns);
+    fprintf(json, ", \"mismatches\": %lu", mismatches);
+    if (mismatches != 0) {
+        fprintf(json, ", \"first_mismatch\": {\"input\": \"%s\", \"expected\": \"%s\", \"got\": \"%s\"}",
+                input, expected, got);
+    }
+    fprintf(json, "}");
+    mismatches_total += mismatches;
+}
+
+static const char *snprintf_format(const to_str_case *c, uint8_t radix) {
+    switch (radix) {
+        case 8:  return c->len ? "%0*o" : "%*o";
+        case 10: return domain_signed(c->dom) ? (c->len ? "%0*lld" : "%*lld") : (c->len ? "%0*llu" : "%*llu");
+        case 16: return c->len ? "%0*llX" : "%*llX";
+        default: return NULL;
+    }
+}
+
+static void bench_to_str(const to_str_case *c, uint8_t radix, dist d, int n) {
+    char expected[STR_SIZE], first_expected[STR_SIZE] = "", first_got[STR_SIZE] = "", first_input[STR_SIZE] = "";
+    unsigned long bad = 0;
+    double utl_ns, snprintf_ns = -1.0, std_ns;
+    const char *fmt;
+    int i;
+
+    make_values(c->dom, d, n);
+    for (i = 0; i < n; i++) {
+        ref_to_str(c, values[i], expected, radix);
+        c->run(values[i], out, radix);
+        if (strcmp(out, expected) != 0) {
+            if (bad++ == 0) {
+                if (domain_signed(c->dom)) snprintf(first_input, sizeof(first_input), "%lld", (long long)values[i]);
+                else snprintf(first_input, sizeof(first_input), "%llu", (unsigned long long)values[i]);
+                strcpy(first_expected, expected);
+                strcpy(first_got, out);
+            }
+        }
+    }
+
+    utl_ns = time_ns(n, [&](int k) { c->run(values[k], out, radix); sink += (uint8_t)out[0]; });
+    fmt = snprintf_format(c, radix);
+    if (fmt != NULL) {
+        snprintf_ns = time_ns(n, [&](int k) {
+            if (radix == 8) snprintf(out, sizeof(out), fmt, c->len, (unsigned)(values[k] & 0xFFFFFFFF));
+            else snprintf(out, sizeof(out), fmt, c->len, (long long)values[k]);
+            sink += (uint8_t)out[0];
+        });
+    }
+    if (domain_signed(c->dom)) {
+        std_ns = time_ns(n, [&](int k) {
+            *std::to_chars(out, out + sizeof(out) - 1, values[k], radix).ptr = '\0';
+            sink += (uint8_t)out[0];
+        });
+    } else {
+        std_ns = time_ns(n, [&](int k) {
+            *std::to_chars(out, out + sizeof(out) - 1, (uint64_t)values[k], radix).ptr = '\0';
+            sink += (uint8_t)out[0];
+        });
+    }
+    json_result(c->name, radix, dist_name[d], n, utl_ns, snprintf_ns, std_ns, "to_chars_ns", -1.0,
+                bad, first_input, first_expected, first_got);
+}
+
+static void bench_from_str(const from_str_case *c, uint8_t radix, dist d, int n) {
+    char first_expected[STR_SIZE] = "", first_got[STR_SIZE] = "", first_input[STR_SIZE] = "";
+    unsigned long bad = 0;
+    double utl_ns, std_ns, strto_ns;
+    int64_t got;
+    char *p;
+    int i;
+
+    make_values(c->dom, d, n);
+    for (i = 0; i < n; i++) {
+        p = strings[i];
+        if (values[i] < 0) *p++ = '-';
+        ref_digits((uint64_t)(values[i] < 0 ? -values[i] : values[i]), p, radix, 0);
+        if (i & 1) {                        // Both cases of the hex digits
+            for (; *p; p++) if (*p >= 'A') *p = (char)(*p - 'A' + 'a');
+        }
+        got = c->run(strings[i], radix);
+        if (got != values[i] && bad++ == 0) {
+            strcpy(first_input, strings[i]);
+            snprintf(first_expected, sizeof(first_expected), "%lld", (long long)values[i]);
+            snprintf(first_got, sizeof(first_got), "%lld", (long long)got);
+        }
+    }
+
+    utl_ns = time_ns(n, [&](int k) { sink += (uint32_t)c->run(strings[k], radix); });
+    if (c->dom == DOM_S32) {
+        strto_ns = time_ns(n, [&](int k) { sink += (uint32_t)strtol(strings[k], NULL, radix); });
+    } else {
+        strto_ns = time_ns(n, [&](int k) { sink += (uint32_t)strtoul(strings[k], NULL, radix); });
+    }
+    std_ns = time_ns(n, [&](int k) {
+        int64_t v = 0;
+        std::from_chars(strings[k], strings[k] + strlen(strings[k]), v, radix);
+        sink += (uint32_t)v;
+    });
+    json_result(c->name, radix, dist_name[d], n, utl_ns, -1.0, std_ns, "from_chars_ns", strto_ns,
+                bad, first_input, first_expected, first_got);
+}
+
+// Fixed point with integer math only: round half away from zero, then split at the point
+static void ref_fixtoa(int64_t v, char *str, size_t size, int scale, int decimals) {
+    uint64_t mag = (uint64_t)(v < 0 ? -v : v), div = 1, unit = 1;
+    int i;
+
+    if (decimals > 9) decimals = 9;         // Like fix_write
+    for (i = decimals; i < scale; i++) div *= 10;
+    mag = (mag + div / 2) / div;
+    for (i = 0; i < decimals; i++) unit *= 10;
+    if (decimals > scale) {
+        for (i = scale; i < decimals; i++) mag *= 10;
+    }
+    if (v < 0 && mag != 0) {
+        *str++ = '-';
+        size--;
+    }
+    if (decimals == 0) snprintf(str, size, "%llu", (unsigned long long)mag);
+    else snprintf(str, size, "%llu.%0*llu", (unsigned long long)(mag / unit), decimals, (unsigned long long)(mag % unit));
+}
+
+// utl_fixtoa next to snprintf("%.*f") and the plain integer conversion of the same value
+static void bench_fixtoa(int n) {
+    static const uint8_t formats[][2] = { { 1, 1 }, { 2, 2 }, { 3, 1 }, { 0, 2 } };
+    char expected[STR_SIZE], name[32], first_expected[STR_SIZE], first_got[STR_SIZE], first_input[STR_SIZE];
+    unsigned long bad;
+    double utl_ns, snprintf_ns, plain_ns;
+    uint8_t scale, decimals;
+    unsigned int f;
+    int d, i;
+
+    for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        scale = formats[f][0];
+        decimals = formats[f][1];
+        for (d = 0; d < DIST_COUNT; d++) {
+            make_values(DOM_S32, (dist)d, n);
+            bad = 0;
+            for (i = 0; i < n; i++) {
+                ref_fixtoa(values[i], expected, sizeof(expected), scale, decimals);
+                utl_fixtoa((int32_t)values[i], out, scale, decimals);
+                if (strcmp(out, expected) != 0 && bad++ == 0) {
+                    snprintf(first_input, sizeof(first_input), "%lld", (long long)values[i]);
+                    strcpy(first_expected, expected);
+                    strcpy(first_got, out);
+                }
+            }
+            utl_ns = time_ns(n, [&](int k) { utl_fixtoa((int32_t)values[k], out, scale, decimals); sink += (uint8_t)out[0]; });
+            snprintf_ns = time_ns(n, [&](int k) {
+                snprintf(out, sizeof(out), "%.*f", decimals, (double)values[k] / pow10_scale(scale));
+                sink += (uint8_t)out[0];
+            });
+            plain_ns = time_ns(n, [&](int k) { utl_i32toa_dec((int32_t)values[k], out); sink += (uint8_t)out[0]; });
+            snprintf(name, sizeof(name), "utl_fixtoa_%u_%u", scale, decimals);
+            json_result(name, 10, dist_name[d], n, utl_ns, snprintf_ns, plain_ns, "i32toa_dec_ns", -1.0,
+                        bad, first_input, first_expected, first_got);
+        }
+    }
+}
+
+// utl_datetime for consecutive seconds, as a clock read on every line, and for random
+// times that change every field. "uncached_ns" clears the cache before every call.
+static void bench_datetime(int n) {
+    static uint16_t year[MAX_INPUTS];
+    static uint8_t field[MAX_INPUTS][5];
+    static const char *dist_names[2] = { "ticking", "random" };
+    char expected[STR_SIZE], first_expected[STR_SIZE] = "", first_got[STR_SIZE] = "", first_input[STR_SIZE] = "";
+    utl_datetime_t datetime;
+    unsigned long bad;
+    double utl_ns, snprintf_ns, uncached_ns;
+    time_t t, start;
+    struct tm *tm;
+    int d, i;
+
+    for (d = 0; d < 2; d++) {
+        start = (time_t)(946684800 + rng() % 3155760000ULL);     // 2000 to 2099
+        for (i = 0; i < n; i++) {
+            t = (d == 0) ? start + i : (time_t)(946684800 + rng() % 3155760000ULL);
+            tm = gmtime(&t);
+            year[i] = (uint16_t)(tm->tm_year + 1900);
+            field[i][0] = (uint8_t)(tm->tm_mon + 1);
+            field[i][1] = (uint8_t)tm->tm_mday;
+            field[i][2] = (uint8_t)tm->tm_hour;
+            field[i][3] = (uint8_t)tm->tm_min;
+            field[i][4] = (uint8_t)tm->tm_sec;
+        }
+        bad = 0;
+        utl_datetime_init(&datetime);
+        for (i = 0; i < n; i++) {
+            snprintf(expected, sizeof(expected), "%04u-%02u-%02u %02u:%02u:%02u", year[i], field[i][0], field[i][1],
+                     field[i][2], field[i][3], field[i][4]);
+            utl_datetime(&datetime, year[i], field[i][0], field[i][1], field[i][2], field[i][3], field[i][4]);
+            if (strcmp(datetime.text, expected) != 0 && bad++ == 0) {
+                strcpy(first_input, expected);
+                strcpy(first_expected, expected);
+                strcpy(first_got, datetime.text);
+            }
+        }
+        utl_ns = time_ns(n, [&](int k) {
+            sink += (uint8_t)utl_datetime(&datetime, year[k], field[k][0], field[k][1], field[k][2], field[k][3], field[k][4])[18];
+        });
+        uncached_ns = time_ns(n, [&](int k) {
+            utl_datetime_init(&datetime);
+            sink += (uint8_t)utl_datetime(&datetime, year[k], field[k][0], field[k][1], field[k][2], field[k][3], field[k][4])[18];
+        });
+        snprintf_ns = time_ns(n, [&](int k) {
+            snprintf(out, sizeof(out), "%04u-%02u-%02u %02u:%02u:%02u", year[k], field[k][0], field[k][1],
+                     field[k][2], field[k][3], field[k][4]);
+            sink += (uint8_t)out[18];
+        });
+        json_result("utl_datetime", 10, dist_names[d], n, utl_ns, snprintf_ns, uncached_ns, "uncached_ns", -1.0,
+                    bad, first_input, first_expected, first_got);
+    }
+}
+
+static void check_parse_cases(void) {
+    unsigned long bad = 0;
+    const char *end;
+    uint8_t status;
+    int32_t value;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(parse_cases) / sizeof(parse_cases[0]); i++) {
+        end = utl_parse_i32(parse_cases[i].str, (uint16_t)strlen(parse_cases[i].str), parse_cases[i].radix, &value, &status);
+        if (value != parse_cases[i].value || status != parse_cases[i].status ||
+            end != parse_cases[i].str + parse_cases[i].end) {
+            fprintf(stderr, "utl_parse_i32(\"%s\", %u): %ld status %u end %ld\n", parse_cases[i].str,
+                    parse_cases[i].radix, (long)value, status, (long)(end - parse_cases[i].str));
+            bad++;
+        }
+    }
+    fprintf(json, "%s\n    {\"function\": \"utl_parse_i32\", \"distribution\": \"edge cases\", \"inputs\": %u, \"mismatches\": %lu}",
+            results++ ? "," : "", i, bad);
+    mismatches_total += bad;
+}
+
+// Bit by bit CRC 16 CCITT, the reference for every UTL_CRC_METHOD
+static uint16_t ref_crc(const uint8_t *data, uint32_t size) {
+    uint16_t crc = UTL_CRC_SEED;
+    uint8_t bit;
+
+    while (size--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void bench_crc(void) {
+    static uint8_t data[4096];
+    static const uint32_t sizes[DIST_COUNT] = { 64, 8, 4096 };
+    static const char *size_name[DIST_COUNT] = { "medium", "small", "large" };
+    char first_expected[STR_SIZE] = "", first_got[STR_SIZE] = "", first_input[STR_SIZE] = "";
+    unsigned long bad = 0;
+    uint16_t got, expected;
+    double utl_ns, ref_ns;
+    uint32_t i, offset;
+    int d;
+
+    for (i = 0; i < sizeof(data); i++) data[i] = (uint8_t)rng();
+    for (d = 0; d < DIST_COUNT; d++) {
+        bad = 0;
+        for (offset = 0; offset + sizes[d] <= sizeof(data); offset += sizes[d] / 2 + 1) {
+            got = utl_calc_crc(data + offset, sizes[d]);
+            expected = ref_crc(data + offset, sizes[d]);
+            if (got != expected && bad++ == 0) {
+                snprintf(first_input, sizeof(first_input), "%lu bytes at %lu", (unsigned long)sizes[d], (unsigned long)offset);
+                snprintf(first_expected, sizeof(first_expected), "%04X", expected);
+                snprintf(first_got, sizeof(first_got), "%04X", got);
+            }
+        }
+        utl_ns = time_ns(16, [&](int k) { sink += utl_calc_crc(data + (k * 7) % (sizeof(data) - sizes[d] + 1), sizes[d]); });
+        ref_ns = time_ns(16, [&](int k) { sink += ref_crc(data + (k * 7) % (sizeof(data) - sizes[d] + 1), sizes[d]); });
+        // Per call of the given size, the reference is the bitwise loop
+        fprintf(json, "%s\n    {\"function\": \"utl_calc_crc\", \"method\": %d, \"distribution\": \"%s\", \"bytes\": %lu",
+                results++ ? "," : "", UTL_CRC_METHOD, size_name[d], (unsigned long)sizes[d]);
+        json_ns("utl_ns", utl_ns);
+        json_ns("bitwise_ns", ref_ns);
+        fprintf(json, ", \"mismatches\": %lu", bad);
+        if (bad != 0) {
+            fprintf(json, ", \"first_mismatch\": {\"input\": \"%s\", \"expected\": \"%s\", \"got\": \"%s\"}",
+                    first_input, first_expected, first_got);
+        }
+        fprintf(json, "}");
+        mismatches_total += bad;
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: utl_bench [-n inputs] [-f function] [-o results.json]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = NULL;
+    unsigned int c;
+    int n = 4096, a, d;
+    uint8_t radix;
+
+    json = stdout;
+    for (a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-n") == 0 && a + 1 < argc) {
+            n = atoi(argv[++a]);
+            if (n < 1 || n > MAX_INPUTS) usage();
+        } else if (strcmp(argv[a], "-f") == 0 && a + 1 < argc) {
+            filter = argv[++a];
+        } else if (strcmp(argv[a], "-o") == 0 && a + 1 < argc) {
+            json = fopen(argv[++a], "w");
+            if (json == NULL) {
+                perror(argv[a]);
+                return 1;
+            }
+        } else {
+            usage();
+        }
+    }
+
+    fprintf(json, "{\n  \"benchmark\": \"utl_bench\",\n  \"unit\": \"ns per call\",\n  \"results\": [");
+    for (c = 0; c < sizeof(to_str_cases) / sizeof(to_str_cases[0]); c++) {
+        if (filter != NULL && strcmp(filter, to_str_cases[c].name) != 0) continue;
+        for (radix = to_str_cases[c].min_radix; radix <= to_str_cases[c].max_radix; radix++) {
+            for (d = 0; d < DIST_COUNT; d++) bench_to_str(&to_str_cases[c], radix, (dist)d, n);
+        }
+    }
+    for (c = 0; c < sizeof(from_str_cases) / sizeof(from_str_cases[0]); c++) {
+        if (filter != NULL && strcmp(filter, from_str_cases[c].name) != 0) continue;
+        for (radix = from_str_cases[c].min_radix; radix <= from_str_cases[c].max_radix; radix++) {
+            for (d = 0; d < DIST_COUNT; d++) bench_from_str(&from_str_cases[c], radix, (dist)d, n);
+        }
+    }
+    if (filter == NULL || strcmp(filter, "utl_parse_i32") == 0) check_parse_cases();
+    if (filter == NULL || strcmp(filter, "utl_fixtoa") == 0) bench_fixtoa(n);
+    if (filter == NULL || strcmp(filter, "utl_datetime") == 0) bench_datetime(n);
+    if (filter == NULL || strcmp(filter, "utl_calc_crc") == 0) bench_crc();
+    fprintf(json, "\n  ],\n  \"mismatches\": %lu\n}\n", mismatches_total);
+    if (json != stdout) fclose(json);
+    if (mismatches_total != 0) {
+        fprintf(stderr, "utl_bench: %lu outputs differ from the reference\n", mismatches_total);
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "uart_debug.h"
-#include <xc.h>
+#include "uart_debug_hal.h"
 #include <stdint.h>
+#include <stdarg.h>
 #include <string.h>
 #include "utl.h"
 #include "softwaretimer.h"
@@ -15,14 +16,501 @@
 #include "adc1.h"
 
 #include "sensorpiccom.h"
+#include "uart_debug_record.h"
+#include "uart_debug_compress.h"
 
 
+#define DEBUG_POWER_OF_TWO(size)    (((size) & ((size) - 1)) == 0)
+#if !DEBUG_POWER_OF_TWO(UART_DEBUG_BUFFER_SIZE) || !DEBUG_POWER_OF_TWO(UART_DEBUG_ALARM_BUFFER_SIZE) || \
+    !DEBUG_POWER_OF_TWO(UART_DEBUG_TELEMETRY_BUFFER_SIZE)
+#error "The debug buffer sizes must be powers of two"
+#endif
+#if !defined(UART_DEBUG_INDEX_32BIT) && (UART_DEBUG_BUFFER_SIZE > 32768 || UART_DEBUG_ALARM_BUFFER_SIZE > 32768 || \
+    UART_DEBUG_TELEMETRY_BUFFER_SIZE > 32768)
+#error "Debug buffer sizes above 32768 need UART_DEBUG_INDEX_32BIT"
+#endif
+#ifdef UART_DEBUG_COMMANDS
+#if (UART_DEBUG_RX_BUFFER_SIZE & (UART_DEBUG_RX_BUFFER_SIZE - 1)) != 0 || (UART_DEBUG_RX_BUFFER_SIZE > 128)
+#error "UART_DEBUG_RX_BUFFER_SIZE must be a power of two, max 128"
+#endif
+#if (UART_DEBUG_COMMAND_BUFFER <= UART_DEBUG_COMMAND_LENGTH) || (UART_DEBUG_COMMAND_BUFFER > 255)
+#error "UART_DEBUG_COMMAND_BUFFER must hold a line of UART_DEBUG_COMMAND_LENGTH and its length, max 255"
+#endif
+#define UART_DEBUG_RX_BUFFER_MASK   (UART_DEBUG_RX_BUFFER_SIZE - 1)
+#endif
+#if defined(UART_DEBUG_COMPRESS) && (DEBUG_COMPRESS_WINDOW_SIZE != 256)
+#error "The compression window is indexed with 8 bits"
+#endif
+
+// The reserve state holds the number of producers busy writing in the upper half
+// and the reserve index in the lower half, so both change in one compare-and-swap
+#ifdef UART_DEBUG_INDEX_32BIT
+typedef uint64_t debug_state_t;
+#define DEBUG_STATE_SHIFT       32
+#else
+typedef uint32_t debug_state_t;
+#define DEBUG_STATE_SHIFT       16
+#endif
+#define DEBUG_STATE(writers, index)     (((debug_state_t)(writers) << DEBUG_STATE_SHIFT) | (debug_index_t)(index))
+#define DEBUG_STATE_WRITERS(state)      ((debug_index_t)((state) >> DEBUG_STATE_SHIFT))
+#define DEBUG_STATE_INDEX(state)        ((debug_index_t)(state))
+
+#if defined(__XC16__)
+// The dsPIC has no compare-and-swap instruction. DISI holds off interrupt
+// priorities 1 to 6 for the few instructions of the swap only, the text itself
+// is always copied with interrupts enabled. Priority 7 interrupts must not log.
+#define DEBUG_ATOMIC(type)              volatile type
+#define debug_atomic_load(ptr)          (*(ptr))
+#define debug_atomic_store(ptr, value)  (*(ptr) = (value))
+
+static uint8_t debug_atomic_cas_state(DEBUG_ATOMIC(debug_state_t) *ptr, debug_state_t *expected, debug_state_t desired){
+    uint8_t done;
+    
+    __builtin_disi(0x3FFF);
+    done = (*ptr == *expected);
+    if (done) *ptr = desired;
+    else *expected = *ptr;
+    DISICNT = 0;
+    return done;
+}
+
+static uint8_t debug_atomic_cas_index(DEBUG_ATOMIC(debug_index_t) *ptr, debug_index_t *expected, debug_index_t desired){
+    uint8_t done;
+    
+    __builtin_disi(0x3FFF);
+    done = (*ptr == *expected);
+    if (done) *ptr = desired;
+    else *expected = *ptr;
+    DISICNT = 0;
+    return done;
+}
+
+static void debug_atomic_add(DEBUG_ATOMIC(uint32_t) *ptr, uint32_t value){
+    __builtin_disi(0x3FFF);
+    *ptr += value;
+    DISICNT = 0;
+}
+
+static uint32_t debug_atomic_take(DEBUG_ATOMIC(uint32_t) *ptr){
+    uint32_t value;
+    
+    __builtin_disi(0x3FFF);
+    value = *ptr;
+    *ptr = 0;
+    DISICNT = 0;
+    return value;
+}
+#else
+#include <stdatomic.h>
+#define DEBUG_ATOMIC(type)              _Atomic type
+#define debug_atomic_load(ptr)          atomic_load(ptr)
+#define debug_atomic_store(ptr, value)  atomic_store(ptr, value)
+#define debug_atomic_cas_state(ptr, expected, desired)  atomic_compare_exchange_weak(ptr, expected, desired)
+#define debug_atomic_cas_index(ptr, expected, desired)  atomic_compare_exchange_weak(ptr, expected, desired)
+#define debug_atomic_add(ptr, value)    atomic_fetch_add(ptr, value)
+#define debug_atomic_take(ptr)          atomic_exchange(ptr, 0)
+#endif
+
+// Lock-free multi producer, single consumer circular buffer, one per lane.
+// Producers reserve room by moving the reserve index, write their text and commit.
+// When the last busy producer commits, in moves up to the reserve index, so the
+// consumer never sees a message that is only partly written. Only the last busy
+// producer moves in, and it does so before it leaves, so in is never moved by two.
+// All indices run freely and are masked on every access, in - out is the number of bytes to send.
+typedef struct{
+    char *data;
+    debug_index_t size;                     // A power of two
+    DEBUG_ATOMIC(debug_state_t) reserve;    // Busy producers and reserve index
+    DEBUG_ATOMIC(debug_index_t) in;         // Everything before in is complete
+    DEBUG_ATOMIC(debug_index_t) out;        // Next byte to send, moved by the consumer and by UART_DEBUG_DROP_OLDEST
+} debug_lane_t;
+static char debug_alarm_data[UART_DEBUG_ALARM_BUFFER_SIZE];
+static char debug_event_data[UART_DEBUG_BUFFER_SIZE];
+static char debug_telemetry_data[UART_DEBUG_TELEMETRY_BUFFER_SIZE];
+// In the order of the lane numbers, the first lane has the highest priority
+static debug_lane_t debug_lanes[UART_DEBUG_LANES] = {
+    {.data = debug_alarm_data,      .size = UART_DEBUG_ALARM_BUFFER_SIZE},
+    {.data = debug_event_data,      .size = UART_DEBUG_BUFFER_SIZE},
+    {.data = debug_telemetry_data,  .size = UART_DEBUG_TELEMETRY_BUFFER_SIZE},
+};
+// Lane the consumer sends from, only used by the consumer
+#define DEBUG_LANE_NONE     0xFF
 static struct{
-    char data[UART_DEBUG_BUFFER_SIZE];
-    uint8_t in;
-    uint8_t out;
-} debug_buffer = {.in = 0, .out = 0};
+    uint8_t lane;                           // DEBUG_LANE_NONE at a message boundary
+    debug_index_t end;                      // End of the messages that are sent from the lane
+} debug_tx = {DEBUG_LANE_NONE, 0};
+// Set while the uart interrupt comes again by itself, the producers then do not request it.
+// The interrupt comes when the transmit buffer becomes empty, so after every call that wrote to it.
+static DEBUG_ATOMIC(uint8_t) debug_tx_running = 0;
+// Data lost because the buffer was full
+static struct{
+    DEBUG_ATOMIC(uint32_t) bytes;
+    DEBUG_ATOMIC(uint32_t) messages;
+    DEBUG_ATOMIC(uint32_t) report;          // Bytes dropped since the last "[N bytes dropped]" line
+} debug_drops;
+#ifdef UART_DEBUG_STATS
+static struct{
+    DEBUG_ATOMIC(debug_index_t) max_used[UART_DEBUG_LANES];
+    DEBUG_ATOMIC(uint32_t) bytes_queued;
+    DEBUG_ATOMIC(uint32_t) producer_count;
+    DEBUG_ATOMIC(uint32_t) producer_cycles;
+    uint32_t bytes_sent;                    // Only changed by the consumer
+    uint32_t isr_count;
+    uint32_t isr_cycles;
+    uint32_t alarm_count;
+    uint32_t alarm_wait;
+    uint32_t alarm_wait_max;
+    uint32_t alarm_since;                   // bytes_sent when the consumer saw the queued alarm
+    uint8_t alarm_queued;
+} debug_stats;
+#endif
+#ifdef UART_DEBUG_COMMANDS
+// Characters received on the uart, the receive interrupt is the only producer
+// and debug_process the only consumer. The indices run freely like the ones above.
+static struct{
+    char data[UART_DEBUG_RX_BUFFER_SIZE];
+    DEBUG_ATOMIC(uint8_t) in;               // Moved by the receive interrupt
+    DEBUG_ATOMIC(uint8_t) out;              // Moved by debug_process
+    DEBUG_ATOMIC(uint8_t) lost;             // Set when a character did not fit
+} debug_rx;
+#endif
+#ifdef UART_DEBUG_COMPRESS
+#define DEBUG_COMPRESS_HASH_SIZE    64      // Must be a power of two
+#define DEBUG_COMPRESS_HASH(text)   ((((uint8_t)(text)[0] << 4) ^ ((uint8_t)(text)[1] << 2) ^ (uint8_t)(text)[2]) & \
+                                     (DEBUG_COMPRESS_HASH_SIZE - 1))
+// Dictionary entry, a literal part of a trace format
+typedef struct {
+    const char *text;
+    uint8_t length;
+} debug_word_t;
+// State of the coder, see uart_debug_compress.h. Only used by the uart interrupt after debug_uart_init.
+static struct{
+    char window[DEBUG_COMPRESS_WINDOW_SIZE];    // Last characters sent, before coding
+    uint8_t head[DEBUG_COMPRESS_HASH_SIZE];     // Window position of the last text with this hash
+    uint8_t position;                           // Next window position, wraps with the window
+    uint8_t code[DEBUG_COMPRESS_CODE_MAX];      // Coded token that is not in the uart yet
+    uint8_t code_length;
+    uint8_t code_sent;
+    uint16_t since_sync;                        // Characters coded since the last sync
+    debug_word_t words[DEBUG_COMPRESS_DICT_SIZE];
+    uint8_t word_count;
+} debug_compress;
+#endif
+#ifdef UART_DEBUG_TIMESTAMPS
+static utl_datetime_t debug_datetime;               // RTC time of the last snapshot, formatted
+#define DEBUG_LINE_PREFIX           debug_datetime.text
+#else
+#define DEBUG_LINE_PREFIX           NULL
+#endif
+static uint8_t debug_policy = UART_DEBUG_DEFAULT_POLICY;
 static uint8_t debug_timer = SOFTWARE_TIMER_NO_TIMER;
+static uint8_t debug_record_timer = SOFTWARE_TIMER_NO_TIMER;
+static uint8_t debug_mode = UART_DEBUG_DEFAULT_MODE;
+static uint8_t debug_record_sequence = 0;
+
+#define DEBUG_DROP_MARKER_LENGTH    32      // Room needed for the "[N bytes dropped]" line
+
+// Timed debug field, one line of debug_process
+#define DEBUG_FIELD_ECU_STATE           0xFF    // Text line with the ECU state and mode, not a trace message
+#define DEBUG_PERIOD_MS(ms)             ((ms) / UART_DEBUG_TICK_MS)
+typedef struct {
+    uint8_t trace;                      // Message in uart_debug_trace.h, label and format of the line
+    uint8_t period;                     // In ticks of UART_DEBUG_TICK_MS, 0 disables the field
+    uint8_t (*get)(uint32_t *args);     // Reads the values, returns the number of arguments
+    uint16_t deadband;                  // Change of a value that is not sent with UART_DEBUG_DELTA_MESSAGES
+} debug_field_t;
+
+// Name of a state value
+typedef struct {
+    uint8_t value;
+    const char *name;
+} debug_name_t;
+
+// Formats of the trace messages, only used when the firmware formats them itself
+#define DEBUG_TRACE_MESSAGE(id, format)     format,
+static const char * const debug_trace_format[DEBUG_TRACE_COUNT] = {
+    DEBUG_TRACE_MESSAGES
+};
+#undef DEBUG_TRACE_MESSAGE
+
+/**
+ * Function prototype:  static uint8_t debug_tx_select(void)
+ * Description:         Picks the lane with the highest priority that has data, at a message
+ *                      boundary. Everything that is complete in it is sent before the next
+ *                      pick, in only stops at the end of a message. Returns 0 when all are empty.
+ */
+static uint8_t debug_tx_select(void){
+    debug_lane_t *lane;
+    uint8_t n;
+    
+    for (n = 0; n < UART_DEBUG_LANES; n++) {
+        lane = &debug_lanes[n];
+        debug_tx.end = debug_atomic_load(&lane->in);
+        if (debug_tx.end != debug_atomic_load(&lane->out)) {
+            break;
+        }
+    }
+#ifdef UART_DEBUG_STATS
+    // Wait of an alarm in characters, from the moment it was seen to its first character
+    if (n == UART_DEBUG_LANE_ALARM) {
+        if (!debug_stats.alarm_queued) {
+            debug_stats.alarm_since = debug_stats.bytes_sent;
+        }
+        debug_stats.alarm_queued = 0;
+        debug_stats.alarm_count++;
+        debug_stats.alarm_wait += debug_stats.bytes_sent - debug_stats.alarm_since;
+        if (debug_stats.bytes_sent - debug_stats.alarm_since > debug_stats.alarm_wait_max) {
+            debug_stats.alarm_wait_max = debug_stats.bytes_sent - debug_stats.alarm_since;
+        }
+    }
+#endif
+    if (n == UART_DEBUG_LANES) {
+        return 0;
+    }
+    debug_tx.lane = n;
+    return 1;
+}
+
+#ifdef UART_DEBUG_COMPRESS
+/**
+ * Function prototype:  static uint8_t debug_compress_digit(char c)
+ * Description:         Position of a character in DEBUG_COMPRESS_DIGITS, 16 when it is not in it
+ */
+static uint8_t debug_compress_digit(char c){
+    const char *digit;
+    
+    if (c >= '0' && c <= '9') {
+        return (uint8_t)(c - '0');
+    }
+    digit = memchr(DEBUG_COMPRESS_DIGITS + 10, c, sizeof(DEBUG_COMPRESS_DIGITS) - 1 - 10);
+    return (digit != NULL) ? (uint8_t)(digit - DEBUG_COMPRESS_DIGITS) : 16;
+}
+
+/**
+ * Function prototype:  static void debug_compress_init(void)
+ * Description:         Clears the window and builds the dictionary from the trace formats
+ */
+static void debug_compress_init(void){
+    const char *text, *part;
+    uint8_t id, length, word;
+    
+    memset(&debug_compress, 0, sizeof(debug_compress));
+    debug_compress.since_sync = DEBUG_COMPRESS_SYNC_CHARS;     // Sync before the first message
+    for (id = 0; id < DEBUG_TRACE_COUNT; id++) {
+        text = debug_trace_format[id];
+        while (*text != '\0') {
+            part = text;
+            while (*text != '\0' && *text != '%') {
+                text++;
+            }
+            length = (text - part > DEBUG_COMPRESS_MATCH_MAX) ? DEBUG_COMPRESS_MATCH_MAX : (uint8_t)(text - part);
+            if (*text == '%') {
+                // Skip the flags, width, precision and the l modifier up to the conversion
+                text++;
+                while (*text != '\0' && *text != '%' &&
+                       (*text == 'l' || !((*text >= 'a' && *text <= 'z') || (*text >= 'A' && *text <= 'Z')))) {
+                    text++;
+                }
+                if (*text != '\0') {
+                    text++;
+                }
+            }
+            if (length < 2 || debug_compress.word_count == DEBUG_COMPRESS_DICT_SIZE) {
+                continue;
+            }
+            for (word = 0; word < debug_compress.word_count; word++) {
+                if (debug_compress.words[word].length == length && memcmp(debug_compress.words[word].text, part, length) == 0) {
+                    break;
+                }
+            }
+            if (word == debug_compress.word_count) {
+                debug_compress.words[word].text = part;
+                debug_compress.words[word].length = length;
+                debug_compress.word_count++;
+            }
+        }
+    }
+}
+
+/**
+ * Function prototype:  static uint8_t debug_compress_token(debug_lane_t *lane, debug_index_t out, debug_index_t available)
+ * Description:         Codes the next token of a lane into debug_compress.code and takes its characters
+ *                      from the lane. Returns the number of characters, 0 when a producer dropped them
+ *                      meanwhile. Every dictionary entry, the window copy and the run compare at most
+ *                      DEBUG_COMPRESS_MATCH_MAX characters, so the time per token is bounded.
+ */
+static uint8_t debug_compress_token(debug_lane_t *lane, debug_index_t out, debug_index_t available){
+    char text[DEBUG_COMPRESS_MATCH_MAX];
+    uint8_t length, kind, count, save, hash = 0, from = 0, i;
+    
+    length = (available > DEBUG_COMPRESS_MATCH_MAX) ? DEBUG_COMPRESS_MATCH_MAX : (uint8_t)available;
+    for (i = 0; i < length; i++) {
+        text[i] = lane->data[(debug_index_t)(out + i) & (lane->size - 1)];
+    }
+    // A literal, unless a token saves more
+    kind = 0;
+    count = 1;
+    save = 0;
+    for (i = 0; i < debug_compress.word_count; i++) {
+        if (debug_compress.words[i].length <= length && debug_compress.words[i].length - 1 > save &&
+            memcmp(debug_compress.words[i].text, text, debug_compress.words[i].length) == 0) {
+            kind = DEBUG_COMPRESS_DICT + i;
+            count = debug_compress.words[i].length;
+            save = count - 1;
+        }
+    }
+    if (length >= DEBUG_COMPRESS_COPY_MIN) {
+        hash = DEBUG_COMPRESS_HASH(text);
+        from = debug_compress.head[hash];
+        // The copy stays behind the current position
+        for (i = 0; i < length && i < (uint8_t)(debug_compress.position - from) &&
+             debug_compress.window[(uint8_t)(from + i)] == text[i]; i++) {
+        }
+        if (i >= DEBUG_COMPRESS_COPY_MIN && i - 2 > save) {
+            kind = DEBUG_COMPRESS_COPY;
+            count = i;
+            save = i - 2;
+        }
+    }
+    for (i = 0; i < length && i < DEBUG_COMPRESS_RUN_MAX && debug_compress_digit(text[i]) < 16; i++) {
+    }
+    if (i >= DEBUG_COMPRESS_RUN_MIN && i - 1 - (i + 1) / 2 > save) {
+        kind = DEBUG_COMPRESS_RUN;
+        count = i;
+    }
+    // Take the characters, a producer may have dropped them to make room
+    if (!debug_atomic_cas_index(&lane->out, &out, out + count)) {
+        return 0;
+    }
+    debug_compress.code_sent = 0;
+    if (kind == DEBUG_COMPRESS_RUN) {
+        debug_compress.code[0] = DEBUG_COMPRESS_RUN + count - DEBUG_COMPRESS_RUN_MIN;
+        for (i = 0; i < count; i += 2) {
+            debug_compress.code[1 + i / 2] = (uint8_t)((debug_compress_digit(text[i]) << 4) |
+                                             ((i + 1 < count) ? debug_compress_digit(text[i + 1]) : 0));
+        }
+        debug_compress.code_length = 1 + (count + 1) / 2;
+    } else if (kind == DEBUG_COMPRESS_COPY) {
+        debug_compress.code[0] = DEBUG_COMPRESS_COPY + count - DEBUG_COMPRESS_COPY_MIN;
+        debug_compress.code[1] = (uint8_t)(debug_compress.position - from);
+        debug_compress.code_length = 2;
+    } else if (kind != 0) {
+        debug_compress.code[0] = kind;
+        debug_compress.code_length = 1;
+    } else if ((uint8_t)text[0] < 0x80) {
+        debug_compress.code[0] = (uint8_t)text[0];
+        debug_compress.code_length = 1;
+    } else {
+        debug_compress.code[0] = DEBUG_COMPRESS_ESCAPE;
+        debug_compress.code[1] = (uint8_t)text[0];
+        debug_compress.code_length = 2;
+    }
+    if (length >= DEBUG_COMPRESS_COPY_MIN) {
+        debug_compress.head[hash] = debug_compress.position;
+    }
+    for (i = 0; i < count; i++) {
+        debug_compress.window[debug_compress.position++] = text[i];
+    }
+    debug_compress.since_sync += count;
+    return count;
+}
+
+/**
+ * Function prototype:  static void debug_compress_sync(void)
+ * Description:         Codes a sync and starts the window over, the host can decode from here
+ *                      without the text before it
+ */
+static void debug_compress_sync(void){
+    memset(debug_compress.window, 0, sizeof(debug_compress.window));
+    memset(debug_compress.head, 0, sizeof(debug_compress.head));
+    debug_compress.position = 0;
+    debug_compress.since_sync = 0;
+    debug_compress.code[0] = DEBUG_COMPRESS_ESCAPE;
+    debug_compress.code[1] = 0x00;
+    debug_compress.code[2] = DEBUG_COMPRESS_ESCAPE;
+    debug_compress.code[3] = 0x00;
+    debug_compress.code_length = DEBUG_COMPRESS_SYNC_LENGTH;
+    debug_compress.code_sent = 0;
+}
+#endif
+
+/**
+ * Function prototype:  static void debug_tx_fill(void)
+ * Description:         Fills the uart transmit buffer till full or no more characters are available
+ */
+static void debug_tx_fill(void){
+    debug_lane_t *lane;
+    debug_index_t out;
+    uint8_t written = 0;
+#ifndef UART_DEBUG_COMPRESS
+    char c;
+#endif
+    
+#ifdef UART_DEBUG_STATS
+    // Only an alarm waiting behind a lower lane, not the one being sent
+    if (!debug_stats.alarm_queued && debug_tx.lane != UART_DEBUG_LANE_ALARM &&
+        debug_atomic_load(&debug_lanes[UART_DEBUG_LANE_ALARM].in) !=
+        debug_atomic_load(&debug_lanes[UART_DEBUG_LANE_ALARM].out)) {
+        debug_stats.alarm_queued = 1;
+        debug_stats.alarm_since = debug_stats.bytes_sent;
+    }
+#endif
+	while (!DEBUG_UART_TX_FULL()) {
+#ifdef UART_DEBUG_COMPRESS
+        if (debug_compress.code_sent != debug_compress.code_length) {
+            DEBUG_UART_TX_WRITE(debug_compress.code[debug_compress.code_sent++]);
+            written = 1;
+            continue;
+        }
+#endif
+        if (debug_tx.lane == DEBUG_LANE_NONE) {
+            if (!debug_tx_select()) {
+                if (written) {
+                    return;         // The interrupt comes again when the buffer is empty
+                }
+                // Nothing comes by itself any more, so the next commit must request the interrupt.
+                // Look once more, a commit may have seen the flag still set.
+                debug_atomic_store(&debug_tx_running, 0);
+                if (!debug_tx_select()) {
+                    return;
+                }
+                debug_atomic_store(&debug_tx_running, 1);
+            }
+#ifdef UART_DEBUG_COMPRESS
+            // Sync at the start of a message now and then
+            if (debug_compress.since_sync >= DEBUG_COMPRESS_SYNC_CHARS) {
+                debug_compress_sync();
+                continue;
+            }
+#endif
+        }
+        lane = &debug_lanes[debug_tx.lane];
+        out = debug_atomic_load(&lane->out);
+        if ((debug_index_t)(debug_tx.end - out) == 0 || (debug_index_t)(debug_tx.end - out) > lane->size) {
+            // Message boundary, UART_DEBUG_DROP_OLDEST may also have moved out past the end
+            debug_tx.lane = DEBUG_LANE_NONE;
+            continue;
+        }
+#ifdef UART_DEBUG_COMPRESS
+#ifdef UART_DEBUG_STATS
+        debug_stats.bytes_sent += debug_compress_token(lane, out, (debug_index_t)(debug_tx.end - out));
+#else
+        debug_compress_token(lane, out, (debug_index_t)(debug_tx.end - out));
+#endif
+#else
+        c = lane->data[out & (lane->size - 1)];
+        // A producer may have dropped this byte to make room, only send it when out did not move
+        if (debug_atomic_cas_index(&lane->out, &out, out + 1)) {
+            // Write character to transmit buffer
+            DEBUG_UART_TX_WRITE(c);
+            written = 1;
+#ifdef UART_DEBUG_STATS
+            debug_stats.bytes_sent++;
+#endif
+        }
+#endif
+	}
+}
 
 /**
  *     <b>Function prototype:</b><br>   _U2TXInterrupt(void)
@@ -38,120 +526,1112 @@ static uint8_t debug_timer = SOFTWARE_TIMER_NO_TIMER;
  * <br>
  * <br><b>Example:</b><br>              
  */
-void __attribute__((interrupt(auto_psv))) _U2TXInterrupt(void){
-	// Fill the buffer till full or no more character are available
-	while (!U2STAbits.UTXBF && (debug_buffer.in != debug_buffer.out)) {
-		// Write character to transmit buffer
-		U2TXREG = debug_buffer.data[debug_buffer.out++];
-        if (debug_buffer.out == UART_DEBUG_BUFFER_SIZE) debug_buffer.out = 0;
-	}
+void DEBUG_UART_TX_ISR(void){
+#ifdef UART_DEBUG_STATS
+    debug_cycles_t start = UART_DEBUG_CYCLES();
+#endif
+    
+	// Clear interrupt flag first, so a producer that sets it while filling is not lost
+	DEBUG_UART_TX_IRQ_CLEAR();
 	
-	// Clear interrupt flag
-	_U2TXIF = 0;
+	debug_tx_fill();
+#ifdef UART_DEBUG_STATS
+    debug_stats.isr_count++;
+    debug_stats.isr_cycles += (debug_cycles_t)(UART_DEBUG_CYCLES() - start);
+#endif
+}
+
+#ifdef UART_DEBUG_COMMANDS
+/**
+ *     <b>Function prototype:</b><br>   _U2RXInterrupt(void)
+ * <br>
+ * <br><b>Description:</b><br>          UART 2 receive interrupt routine.
+ * <br>                                 Moves the received characters to the receive buffer,
+ * <br>                                 debug_process reads the commands from there.
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized
+ * <br>
+ * <br><b>Inputs:</b><br>               None
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              
+ */
+void DEBUG_UART_RX_ISR(void){
+    uint8_t in;
+    char c;
+    
+    DEBUG_UART_RX_IRQ_CLEAR();
+    
+    in = debug_atomic_load(&debug_rx.in);
+    while (DEBUG_UART_RX_AVAILABLE()) {
+        c = DEBUG_UART_RX_READ();
+        if ((uint8_t)(in - debug_atomic_load(&debug_rx.out)) < UART_DEBUG_RX_BUFFER_SIZE) {
+            debug_rx.data[in & UART_DEBUG_RX_BUFFER_MASK] = c;
+            in++;
+            debug_atomic_store(&debug_rx.in, in);
+        } else {
+            debug_atomic_store(&debug_rx.lost, 1);
+        }
+    }
+    // The receiver stops after an overrun, the characters in the fifo are read already
+    if (DEBUG_UART_RX_OVERRUN()) {
+        DEBUG_UART_RX_OVERRUN_CLEAR();
+        debug_atomic_store(&debug_rx.lost, 1);
+    }
+}
+#endif
+
+/**
+ * Function prototype:  static debug_index_t debug_free(const debug_lane_t *lane)
+ * Description:         Returns the number of bytes that can be reserved in the buffer of a lane
+ */
+static debug_index_t debug_free(const debug_lane_t *lane){
+    debug_index_t reserve;
+    
+    reserve = DEBUG_STATE_INDEX(debug_atomic_load(&lane->reserve));
+    return lane->size - (debug_index_t)(reserve - debug_atomic_load(&lane->out));
+}
+
+/**
+ * Function prototype:  static void debug_tx_start(void)
+ * Description:         Starts the interrupts by setting the interrupt flag, unless the
+ *                      interrupt still comes by itself. The interrupt is the only consumer
+ *                      of the buffer, so any producer, at any priority, can start it.
+ */
+static void debug_tx_start(void){
+    if (!debug_atomic_load(&debug_tx_running)) {
+        debug_atomic_store(&debug_tx_running, 1);
+        DEBUG_UART_TX_IRQ_SET();
+    }
+}
+
+/**
+ * Function prototype:  static void debug_copy(const debug_span_t *span, const char *src)
+ * Description:         Copies span->len[0] + span->len[1] characters into a reserved span
+ */
+static void debug_copy(const debug_span_t *span, const char *src){
+    memcpy(span->ptr[0], src, span->len[0]);
+    if (span->len[1] != 0) {
+        memcpy(span->ptr[1], src + span->len[0], span->len[1]);
+    }
+}
+
+/**
+ * Function prototype:  static void debug_count_drop(debug_index_t bytes, uint32_t messages)
+ * Description:         Counts lost data
+ */
+static void debug_count_drop(debug_index_t bytes, uint32_t messages){
+    debug_atomic_add(&debug_drops.bytes, bytes);
+    debug_atomic_add(&debug_drops.messages, messages);
+    debug_atomic_add(&debug_drops.report, bytes);
+}
+
+/**
+ * Function prototype:  static uint8_t debug_drop_oldest(debug_lane_t *lane, debug_index_t size)
+ * Description:         Drops at least size bytes of complete data that is not sent yet,
+ *                      up to the end of a line. Returns 0 when there is nothing to drop,
+ *                      all room is then held by producers that are still writing.
+ */
+static uint8_t debug_drop_oldest(debug_lane_t *lane, debug_index_t size){
+    debug_index_t in, out, end, mask = lane->size - 1;
+    uint32_t lines = 0;
+    
+    in = debug_atomic_load(&lane->in);
+    out = debug_atomic_load(&lane->out);
+    if (in == out) {
+        return 0;
+    }
+    // Everything before in is complete, so in is always the end of a message
+    for (end = out; end != in; end++) {
+        if (lane->data[end & mask] == '\n') {
+            lines++;
+            if ((debug_index_t)(end + 1 - out) >= size) {
+                end++;
+                break;
+            }
+        }
+    }
+    if (end == in && lane->data[(in - 1) & mask] != '\n') {
+        lines++;
+    }
+    // The consumer may have sent some of it meanwhile, then the caller tries again
+    if (debug_atomic_cas_index(&lane->out, &out, end)) {
+        debug_count_drop(end - out, lines);
+    }
+    return 1;
+}
+
+#ifdef UART_DEBUG_STATS
+/**
+ * Function prototype:  static void debug_stats_used(uint8_t lane_number, debug_index_t end)
+ * Description:         Updates the high water mark of a lane, end is the reserve index after a reserve
+ */
+static void debug_stats_used(uint8_t lane_number, debug_index_t end){
+    DEBUG_ATOMIC(debug_index_t) *max = &debug_stats.max_used[lane_number];
+    debug_index_t used, max_used;
+    
+    used = end - debug_atomic_load(&debug_lanes[lane_number].out);
+    max_used = debug_atomic_load(max);
+    while (used > max_used && !debug_atomic_cas_index(max, &max_used, used)) {
+    }
+}
+#endif
+
+// Policy of the streams: all of size or nothing, no data is dropped and nothing is counted,
+// the stream tries again on the next call. Only used inside this file.
+#define DEBUG_POLICY_RETRY              4
+
+/**
+ * Function prototype:  static debug_index_t debug_reserve_policy(uint8_t lane_number, debug_index_t size, debug_span_t *span, uint8_t policy)
+ * Description:         Reserves up to size bytes in the buffer of a lane, as one or two contiguous parts,
+ *                      with the given policy when there is not enough room
+ */
+static debug_index_t debug_reserve_policy(uint8_t lane_number, debug_index_t size, debug_span_t *span, uint8_t policy){
+    debug_lane_t *lane;
+    debug_state_t state;
+    debug_index_t available, first, index, wanted;
+    uint16_t loops = 0;
+    
+#ifdef UART_DEBUG_STATS
+    span->start = UART_DEBUG_CYCLES();
+#endif
+    if (lane_number >= UART_DEBUG_LANES) {
+        lane_number = UART_DEBUG_LANE_EVENT;
+    }
+    lane = &debug_lanes[lane_number];
+    span->lane = lane_number;
+    if (size > lane->size) {
+        size = lane->size;
+    }
+    wanted = size;
+    state = debug_atomic_load(&lane->reserve);
+    for (;;) {
+        index = DEBUG_STATE_INDEX(state);
+        available = lane->size - (debug_index_t)(index - debug_atomic_load(&lane->out));
+        size = wanted;
+        if (size > available) {
+            // No more room is available in the buffer
+            if (policy == UART_DEBUG_BLOCK && loops < UART_DEBUG_BLOCK_LOOPS) {
+                // wait till room is available
+                loops++;
+                Nop();
+                state = debug_atomic_load(&lane->reserve);
+                continue;
+            }
+            if (policy == UART_DEBUG_DROP_OLDEST && debug_drop_oldest(lane, wanted - available)) {
+                state = debug_atomic_load(&lane->reserve);
+                continue;
+            }
+            // Drop newest sends what fits, so does drop oldest when nothing is left to drop
+            size = (policy == UART_DEBUG_DROP_NEWEST || policy == UART_DEBUG_DROP_OLDEST) ? available : 0;
+        }
+        if (size == 0) {
+            span->len[0] = 0;
+            span->len[1] = 0;
+            if (wanted != 0 && policy != DEBUG_POLICY_RETRY) {
+                debug_count_drop(wanted, 1);
+            }
+            return 0;
+        }
+        // Claim the room and count this producer as busy
+        if (debug_atomic_cas_state(&lane->reserve, &state,
+                                   DEBUG_STATE(DEBUG_STATE_WRITERS(state) + 1, index + size))) {
+            break;
+        }
+    }
+    if (size != wanted) {
+        debug_count_drop(wanted - size, 1);
+    }
+#ifdef UART_DEBUG_STATS
+    debug_stats_used(lane_number, index + size);
+#endif
+    
+    // Split the span where the buffer wraps
+    index &= lane->size - 1;
+    first = lane->size - index;
+    if (first > size) {
+        first = size;
+    }
+    span->ptr[0] = &lane->data[index];
+    span->len[0] = first;
+    span->ptr[1] = &lane->data[0];
+    span->len[1] = size - first;
+    return size;
+}
+
+/**
+ * Function prototype:  debug_index_t debug_reserve_lane(uint8_t lane_number, debug_index_t size, debug_span_t *span)
+ * Description:         Reserves up to size bytes in the buffer of a lane, as one or two contiguous parts
+ */
+debug_index_t debug_reserve_lane(uint8_t lane_number, debug_index_t size, debug_span_t *span){
+    return debug_reserve_policy(lane_number, size, span, debug_policy);
+}
+
+/**
+ * Function prototype:  debug_index_t debug_reserve(debug_index_t size, debug_span_t *span)
+ * Description:         Reserves up to size bytes in the event lane
+ */
+debug_index_t debug_reserve(debug_index_t size, debug_span_t *span){
+    return debug_reserve_lane(UART_DEBUG_LANE_EVENT, size, span);
+}
+
+/**
+ * Function prototype:  void debug_commit(const debug_span_t *span)
+ * Description:         Publishes a reserved span to the uart port
+ */
+void debug_commit(const debug_span_t *span){
+    debug_lane_t *lane = &debug_lanes[span->lane];
+    debug_state_t state;
+    
+    if (span->len[0] == 0) {
+        return;                     // Nothing was reserved
+    }
+#ifdef UART_DEBUG_STATS
+    debug_atomic_add(&debug_stats.bytes_queued, span->len[0] + span->len[1]);
+    debug_atomic_add(&debug_stats.producer_count, 1);
+    debug_atomic_add(&debug_stats.producer_cycles, (debug_cycles_t)(UART_DEBUG_CYCLES() - span->start));
+#endif
+    // This producer is done
+    state = debug_atomic_load(&lane->reserve);
+    do {
+        if (DEBUG_STATE_WRITERS(state) == 1) {
+            // Last busy producer, everything up to the reserve index is complete. No other
+            // producer can be the last one till this one leaves, so a plain store does.
+            debug_atomic_store(&lane->in, DEBUG_STATE_INDEX(state));
+        }
+    } while (!debug_atomic_cas_state(&lane->reserve, &state,
+                                     DEBUG_STATE(DEBUG_STATE_WRITERS(state) - 1, DEBUG_STATE_INDEX(state))));
+    if (DEBUG_STATE_WRITERS(state) == 1) {
+        debug_tx_start();
+    }
+}
+
+/**
+ * Function prototype:  static void debug_string_lane(uint8_t lane, const char *str)
+ * Description:         Prints a null terminated string in a lane
+ */
+static void debug_string_lane(uint8_t lane, const char *str){
+    debug_span_t span;
+    
+    if (debug_reserve_lane(lane, strlen(str), &span) != 0) {
+        debug_copy(&span, str);
+        debug_commit(&span);
+    }
+}
+
+/**
+ * Function prototype:  void debug_string(char *str)
+ * Description:         Prints a null terminated string to the uart port
+ */
+void debug_string(char *str){
+    debug_string_lane(UART_DEBUG_LANE_EVENT, str);
+}
+
+/**
+ * Function prototype:  void debug_char(char value)
+ * Description:         Prints an char to the uart port
+ */
+void debug_char(char value){
+    debug_span_t span;
+    
+    if (debug_reserve(1, &span) != 0) {
+        *span.ptr[0] = value;
+        debug_commit(&span);
+    }
+}
+
+/**
+ * Function prototype:  void debug_uint(uint32_ value)
+ * Description:         Prints an unsigned integer to the uart port
+ */
+void debug_uint(uint32_t value){
+    debug_span_t span;
+    char temp_str[16];
+    uint8_t len;
+    
+    len = utl_dec_digits(value);
+    if (debug_reserve(len, &span) == len && span.len[1] == 0) {
+        // Write the digits straight into the buffer
+        utl_ui32toa_fixed(value, span.ptr[0], len);
+        debug_commit(&span);
+    } else if (span.len[0] != 0) {
+        // Wrapped or truncated, convert the value to a string first
+        utl_ui32toa_fixed(value, temp_str, len);
+        debug_copy(&span, temp_str);
+        debug_commit(&span);
+    }
+}
+
+/**
+ * Function prototype:  void debug_int(int32_t value)
+ * Description:         Prints an integer to the uart port
+ */
+void debug_int(int32_t value){
+    debug_span_t span;
+    char temp_str[16];
+    uint32_t magnitude;
+    uint8_t len, sign;
+    
+    sign = (value < 0) ? 1 : 0;
+    magnitude = sign ? 0UL - (uint32_t)value : (uint32_t)value;
+    len = utl_dec_digits(magnitude);
+    if (debug_reserve(len + sign, &span) == len + sign && span.len[1] == 0) {
+        // Write the digits straight into the buffer
+        if (sign) span.ptr[0][0] = '-';
+        utl_ui32toa_fixed(magnitude, span.ptr[0] + sign, len);
+        debug_commit(&span);
+    } else if (span.len[0] != 0) {
+        // Wrapped or truncated, convert the value to a string first
+        temp_str[0] = '-';
+        utl_ui32toa_fixed(magnitude, temp_str + sign, len);
+        debug_copy(&span, temp_str);
+        debug_commit(&span);
+    }
+}
+
+void debug_int_len(int32_t value, uint8_t len){
+    debug_span_t span;
+    char temp_str[16];
+    uint8_t digits;
+    
+    // Same as utl_i32toa_l, the value is printed unsigned and padded with 0
+    digits = utl_dec_digits((uint32_t)value);
+    if (len < digits) len = digits;
+    if (len > sizeof(temp_str)) len = sizeof(temp_str);
+    if (debug_reserve(len, &span) == len && span.len[1] == 0) {
+        // Write the digits straight into the buffer
+        utl_ui32toa_fixed((uint32_t)value, span.ptr[0], len);
+        debug_commit(&span);
+    } else if (span.len[0] != 0) {
+        // Wrapped or truncated, convert the value to a string first
+        utl_ui32toa_fixed((uint32_t)value, temp_str, len);
+        debug_copy(&span, temp_str);
+        debug_commit(&span);
+    }
+}
+
+/**
+ * Function prototype:  void debug_hex(uint32_t value)
+ * Description:         Prints an unsigned integer as a hex string to the uart port
+ */
+void debug_hex(uint32_t value){
+    debug_span_t span;
+    char temp_str[16];
+    uint8_t len;
+    
+    len = utl_hex_digits(value);
+    if (debug_reserve(len, &span) == len && span.len[1] == 0) {
+        // Write the digits straight into the buffer
+        utl_ui32toa_hex_fixed(value, span.ptr[0], len, UTL_UPPERCASE);
+        debug_commit(&span);
+    } else if (span.len[0] != 0) {
+        // Wrapped or truncated, convert the value to a string first
+        utl_ui32toa_hex_fixed(value, temp_str, len, UTL_UPPERCASE);
+        debug_copy(&span, temp_str);
+        debug_commit(&span);
+    }
+}
+
+/**
+ * Function prototype:  void debug_printf(const char *fmt, ...)
+ * Description:         Formats a line and prints it to the uart port in one call
+ */
+void debug_printf(const char *fmt, ...){
+    char temp_str[DEBUG_PRINTF_LENGTH];
+    va_list args;
+    // Format the complete line
+    va_start(args, fmt);
+    utl_vsnprintf(temp_str, sizeof(temp_str), fmt, args);
+    va_end(args);
+    // Put the string in the buffer
+    debug_string(temp_str);
+}
+
+/**
+ * Function prototype:  void debug_printf_lane(uint8_t lane, const char *fmt, ...)
+ * Description:         Formats a line and prints it in a lane
+ */
+void debug_printf_lane(uint8_t lane, const char *fmt, ...){
+    char temp_str[DEBUG_PRINTF_LENGTH];
+    va_list args;
+    
+    va_start(args, fmt);
+    utl_vsnprintf(temp_str, sizeof(temp_str), fmt, args);
+    va_end(args);
+    debug_string_lane(lane, temp_str);
+}
+
+/**
+ * Function prototype:  static void debug_printf_prefix(uint8_t lane, const char *prefix, const char *fmt, ...)
+ * Description:         Prints a formatted line to a lane, after prefix and a space when prefix is not NULL
+ */
+static void debug_printf_prefix(uint8_t lane, const char *prefix, const char *fmt, ...){
+    char temp_str[DEBUG_PRINTF_LENGTH + UTL_DATETIME_LENGTH + 1];  // The line gets the full length after the time
+    uint8_t length = 0;
+    va_list args;
+    
+    if (prefix != NULL) {
+        length = (strlen(prefix) > UTL_DATETIME_LENGTH) ? UTL_DATETIME_LENGTH : (uint8_t)strlen(prefix);
+        memcpy(temp_str, prefix, length);
+        temp_str[length++] = ' ';
+    }
+    va_start(args, fmt);
+    utl_vsnprintf(temp_str + length, sizeof(temp_str) - length, fmt, args);
+    va_end(args);
+    debug_string_lane(lane, temp_str);
+}
+
+/**
+ * Function prototype:  void debug_stream_start(debug_stream_t *stream, uint8_t lane, debug_stream_line_t line, const void *context, uint16_t count)
+ * Description:         Starts output that is sent a piece at a time by debug_stream_process
+ */
+void debug_stream_start(debug_stream_t *stream, uint8_t lane, debug_stream_line_t line, const void *context, uint16_t count){
+    stream->lane = lane;
+    stream->line = line;
+    stream->context = context;
+    stream->count = count;
+    stream->index = 0;
+    stream->length = 0;
+    stream->position = 0;
+}
+
+/**
+ * Function prototype:  uint8_t debug_stream_process(debug_stream_t *stream)
+ * Description:         Sends as much of a stream as fits, returns 1 while text is left
+ */
+uint8_t debug_stream_process(debug_stream_t *stream){
+    debug_lane_t *lane = &debug_lanes[stream->lane < UART_DEBUG_LANES ? stream->lane : UART_DEBUG_LANE_EVENT];
+    debug_span_t span;
+    debug_index_t room, size;
+    
+    for (;;) {
+        if (stream->position == stream->length) {
+            // Line done, format the next one
+            if (stream->line == 0) {
+                return 0;
+            }
+            stream->length = stream->line(stream, stream->text, sizeof(stream->text));
+            stream->position = 0;
+            if (stream->length == 0) {
+                stream->line = 0;
+                return 0;
+            }
+            stream->index++;
+        }
+        // Only the upper half of the free space, the rest is for instant messages
+        room = debug_free(lane);
+        if (room <= lane->size / 2) {
+            return 1;
+        }
+        room -= lane->size / 2;
+        size = stream->length - stream->position;
+        if (size > room) {
+            // Whole lines, so instant messages do not land inside a line. A line that
+            // is longer than half the buffer is sent in parts.
+            if (stream->position == 0 && stream->length <= lane->size / 2) {
+                return 1;
+            }
+            size = room;
+        }
+        // A producer may have taken the room since debug_free, then this is tried again
+        size = debug_reserve_policy(stream->lane, size, &span, DEBUG_POLICY_RETRY);
+        if (size == 0) {
+            return 1;
+        }
+        debug_copy(&span, &stream->text[stream->position]);
+        debug_commit(&span);
+        stream->position += size;
+    }
+}
+
+/**
+ * Function prototype:  static uint8_t debug_dump_line(const debug_stream_t *stream, char *str, uint8_t size)
+ * Description:         Formats line stream->index of a hex dump, 16 bytes per line
+ */
+static uint8_t debug_dump_line(const debug_stream_t *stream, char *str, uint8_t size){
+    const uint8_t *data = (const uint8_t *)stream->context;
+    uint32_t offset = (uint32_t)stream->index * 16;     // 32 bit, so a dump of up to 65535 bytes ends
+    uint8_t len = 0;
+    
+    if (offset >= stream->count || size < 4 + 2 + 16 * 3 + 2) {
+        return 0;
+    }
+    utl_ui32toa_hex_fixed(offset, str, 4, UTL_UPPERCASE);
+    str[4] = ':';
+    len = 5;
+    for ( ; offset < stream->count && len < 5 + 16 * 3; offset++) {
+        str[len] = ' ';
+        utl_ui32toa_hex_fixed(data[offset], &str[len + 1], 2, UTL_UPPERCASE);
+        len += 3;
+    }
+    str[len++] = '\r';
+    str[len++] = '\n';
+    return len;
+}
+
+/**
+ * Function prototype:  void debug_stream_dump(debug_stream_t *stream, uint8_t lane, const void *data, uint16_t size)
+ * Description:         Starts a hex dump as a stream
+ */
+void debug_stream_dump(debug_stream_t *stream, uint8_t lane, const void *data, uint16_t size){
+    debug_stream_start(stream, lane, debug_dump_line, data, size);
+}
+
+/**
+ * Function prototype:  void debug_set_mode(uint8_t mode)
+ * Description:         Selects ASCII lines or binary records for the timed debug messages
+ */
+void debug_set_mode(uint8_t mode){
+    debug_mode = mode;
+}
+
+/**
+ * Function prototype:  void debug_set_policy(uint8_t policy)
+ * Description:         Selects what a print does when the debug buffer is full
+ */
+void debug_set_policy(uint8_t policy){
+    debug_policy = policy;
+}
+
+/**
+ * Function prototype:  uint32_t debug_dropped_bytes(void)
+ * Description:         Returns the number of bytes that were dropped since the start
+ */
+uint32_t debug_dropped_bytes(void){
+    return debug_atomic_load(&debug_drops.bytes);
+}
+
+/**
+ * Function prototype:  uint32_t debug_dropped_messages(void)
+ * Description:         Returns the number of messages that were dropped or cut off since the start
+ */
+uint32_t debug_dropped_messages(void){
+    return debug_atomic_load(&debug_drops.messages);
+}
+
+#ifdef UART_DEBUG_STATS
+/**
+ * Function prototype:  static void debug_stats_copy(debug_stats_t *stats)
+ * Description:         Copies the counters, the caller makes sure they are not torn
+ */
+static void debug_stats_copy(debug_stats_t *stats){
+    uint8_t n;
+    
+    for (n = 0; n < UART_DEBUG_LANES; n++) {
+        stats->max_used[n] = debug_atomic_load(&debug_stats.max_used[n]);
+    }
+    stats->bytes_queued = debug_atomic_load(&debug_stats.bytes_queued);
+    stats->bytes_sent = debug_stats.bytes_sent;
+    stats->isr_count = debug_stats.isr_count;
+    stats->isr_cycles = debug_stats.isr_cycles;
+    stats->producer_count = debug_atomic_load(&debug_stats.producer_count);
+    stats->producer_cycles = debug_atomic_load(&debug_stats.producer_cycles);
+    stats->alarm_count = debug_stats.alarm_count;
+    stats->alarm_wait = debug_stats.alarm_wait;
+    stats->alarm_wait_max = debug_stats.alarm_wait_max;
+}
+#endif
+
+/**
+ * Function prototype:  void debug_get_stats(debug_stats_t *stats)
+ * Description:         Reads the measurements of the debug output since the start.
+ *                      The 32 bit counters take two loads on the dsPIC and the uart interrupt
+ *                      may change them in between, so they are copied with DISI like the
+ *                      queue does. On the host they are copied till two copies match.
+ */
+void debug_get_stats(debug_stats_t *stats){
+#if defined(UART_DEBUG_STATS) && !defined(__XC16__)
+    debug_stats_t check;
+#endif
+    
+    memset(stats, 0, sizeof(debug_stats_t));
+#ifdef UART_DEBUG_STATS
+#if defined(__XC16__)
+    __builtin_disi(0x3FFF);
+    debug_stats_copy(stats);
+    DISICNT = 0;
+#else
+    debug_stats_copy(stats);
+    do {
+        memcpy(&check, stats, sizeof(debug_stats_t));
+        debug_stats_copy(stats);
+    } while (memcmp(&check, stats, sizeof(debug_stats_t)) != 0);
+#endif
+#endif
+    stats->dropped_bytes = debug_atomic_load(&debug_drops.bytes);
+    stats->dropped_messages = debug_atomic_load(&debug_drops.messages);
+}
+
+// Little endian field writers for the binary record
+static void debug_put16(uint8_t *field, uint16_t value){
+    field[0] = (uint8_t)value;
+    field[1] = (uint8_t)(value >> 8);
+}
+
+static void debug_put32(uint8_t *field, uint32_t value){
+    field[0] = (uint8_t)value;
+    field[1] = (uint8_t)(value >> 8);
+    field[2] = (uint8_t)(value >> 16);
+    field[3] = (uint8_t)(value >> 24);
+}
+
+/**
+ * Function prototype:  static void debug_record_fill(debug_record_t *record)
+ * Description:         Reads all telemetry values into a binary record
+ */
+static void debug_record_fill(debug_record_t *record){
+    record->ecu_state[0] = get_ecu_state();
+    record->ecu_mode[0] = get_ecu_mode();
+    record->buttons[0] = (get_user_interface_button_state(BUTTON_LOCAL_ROM_START_STOP, BUTTON_DOWN) ? 0x01 : 0) |
+                         (get_user_interface_button_state(BUTTON_LOCAL_ROM_MODE, BUTTON_DOWN) ? 0x02 : 0) |
+                         (get_user_interface_button_state(SWITCH_LOCAL_ROM_LOCAL, BUTTON_DOWN) ? 0x04 : 0) |
+                         (get_user_interface_button_state(SWITCH_LOCAL_ROM_REMOTE, BUTTON_DOWN) ? 0x08 : 0) |
+                         (get_user_interface_button_state(BUTTON_REMOTE_ROM_START_STOP, BUTTON_DOWN) ? 0x10 : 0);
+    record->dig_closed[0] = (get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_1) ? 0x01 : 0) |
+                            (get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_2) ? 0x02 : 0) |
+                            (get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_3) ? 0x04 : 0) |
+                            (get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_4) ? 0x08 : 0);
+    record->dig_activated[0] = (get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_1) ? 0x01 : 0) |
+                               (get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_2) ? 0x02 : 0) |
+                               (get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_3) ? 0x04 : 0) |
+                               (get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_4) ? 0x08 : 0);
+    record->alt_activated[0] = get_sensor_alt_feedback_is_activated();
+    record->e_stop_closed[0] = get_sensor_e_stop_is_closed();
+    record->e_stop_activated[0] = get_sensor_e_stop_is_activated();
+    
+    debug_put16(record->an_sensor_1_raw, get_sensor_pic_engine_analog_sensor_raw(SENSOR_PIC_COM_AN_SENSOR_1));
+    debug_put16(record->an_sensor_2_raw, get_sensor_pic_engine_analog_sensor_raw(SENSOR_PIC_COM_AN_SENSOR_2));
+    debug_put16(record->userio_analog, get_userio_analog_input_value());
+    debug_put16(record->adc_user_raw, get_adc1_raw_value(ADC1_RESULT_USER_SENSOR));
+    debug_put16(record->pt100_raw, get_sensor_pic_pt100_temperature_raw(1));
+    debug_put16(record->temp_1_100mdeg, get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_1));
+    debug_put16(record->temp_2_100mdeg, get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_2));
+    debug_put16(record->temp_3_100mdeg, get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_3));
+    debug_put16(record->battery_mv, get_sensor_battery_voltage_mv());
+    debug_put16(record->battery_raw, get_adc1_raw_value(ADC1_RESULT_BATT_SENSE));
+    
+    debug_put16(record->gen_v_1_100mv, get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_1));
+    debug_put16(record->gen_v_2_100mv, get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_2));
+    debug_put16(record->gen_v_3_100mv, get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_3));
+    debug_put16(record->gen_a_1_100ma, get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_1));
+    debug_put16(record->gen_a_2_100ma, get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_2));
+    debug_put16(record->gen_a_3_100ma, get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_3));
+    debug_put32(record->gen_va_1, get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_1));
+    debug_put32(record->gen_va_2, get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_2));
+    debug_put32(record->gen_va_3, get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_3));
+    debug_put16(record->gen_freq_10mhz, get_generator_measure_voltage_freq_10mhz());
+    debug_put16(record->gen_rpm, get_generator_measure_rpm());
+    debug_put32(record->gen_total_va, get_generator_measure_total_power_va());
+    
+    record->alarm_sensor_dig_1[0] = get_alarms_state(ALARM_SENSOR_DIGITAL_1);
+    record->alarm_sensor_dig_2[0] = get_alarms_state(ALARM_SENSOR_DIGITAL_2);
+    record->alarm_sensor_dig_3[0] = get_alarms_state(ALARM_SENSOR_DIGITAL_3);
+    record->alarm_sensor_dig_4[0] = get_alarms_state(ALARM_SENSOR_DIGITAL_4);
+    record->alarm_sensor_an_1[0] = get_alarms_state(ALARM_SENSOR_ANALOG_1);
+    record->alarm_sensor_an_2[0] = get_alarms_state(ALARM_SENSOR_ANALOG_2);
+    record->alarm_gen_low_v_1[0] = get_alarms_state(ALARM_GENERATOR_LOW_VOLTAGE_1);
+    record->alarm_gen_low_v_2[0] = get_alarms_state(ALARM_GENERATOR_LOW_VOLTAGE_2);
+    record->alarm_gen_high_v_1[0] = get_alarms_state(ALARM_GENERATOR_HIGH_VOLTAGE_1);
+    record->alarm_gen_high_v_2[0] = get_alarms_state(ALARM_GENERATOR_HIGH_VOLTAGE_2);
+    record->alarm_gen_high_a_1[0] = get_alarms_state(ALARM_GENERATOR_HIGH_CURRENT_1);
+    record->alarm_gen_high_a_2[0] = get_alarms_state(ALARM_GENERATOR_HIGH_CURRENT_2);
+    record->alarm_gen_high_p_1[0] = get_alarms_state(ALARM_GENERATOR_HIGH_POWER_1);
+    record->alarm_gen_high_p_2[0] = get_alarms_state(ALARM_GENERATOR_HIGH_POWER_2);
+    record->alarm_batt_low_v[0] = get_alarms_state(ALARM_BATTERY_LOW_VOLTAGE);
+    record->alarm_batt_no_charge[0] = get_alarms_state(ALARM_BATTERY_FAILED_TO_CHARGE);
+    record->alarm_low_rpm_1[0] = get_alarms_state(ALARM_ENGINE_LOW_RPM_1);
+    record->alarm_low_rpm_2[0] = get_alarms_state(ALARM_ENGINE_LOW_RPM_2);
+    record->alarm_high_rpm_1[0] = get_alarms_state(ALARM_ENGINE_HIGH_RPM_1);
+    record->alarm_high_rpm_2[0] = get_alarms_state(ALARM_ENGINE_HIGH_RPM_2);
+    record->alarm_fail_start[0] = get_alarms_state(ALARM_GENERIC_FAILED_TO_START);
+    record->alarm_fail_stop[0] = get_alarms_state(ALARM_GENERIC_FAILED_TO_STOP);
+    record->alarm_e_stop[0] = get_alarms_state(ALARM_GENERIC_E_STOP);
+    record->alarm_maintenance[0] = get_alarms_state(ALARM_GENERIC_MAINTENANCE);
+    record->alarm_user_dig_1[0] = get_alarms_state(ALARM_GENERIC_USER_DIG_1);
+    record->alarm_user_dig_2[0] = get_alarms_state(ALARM_GENERIC_USER_DIG_2);
+    record->alarm_user_an[0] = get_alarms_state(ALARM_GENERIC_USER_AN);
+    record->pic_com_state[0] = get_sensor_pic_com_state();
 }
 
 /**
- * Function prototype:  void debug_string(char *str)
- * Description:         Prints a null terminated string to the uart port
+ * Function prototype:  static void debug_send_frame(uint8_t lane, uint8_t *frame, uint16_t size)
+ * Description:         Adds the crc to a frame, encodes it with COBS and sends it in one burst.
+ *                      The frame is put between two 0x00 delimiters, so text that is printed
+ *                      in between frames is never mistaken for a frame.
  */
-void debug_string(char *str){
-    uint8_t temp_in;
+static void debug_send_frame(uint8_t lane, uint8_t *frame, uint16_t size){
+    uint8_t encoded[UTL_COBS_MAX_SIZE(DEBUG_FRAME_SIZE) + 2];
+    debug_span_t span;
+    uint16_t encoded_size;
+    uint8_t policy = debug_policy;
     
-    // Fill the buffer
-    while (*str != '\0') {
-        temp_in = debug_buffer.in + 1;
-        if (temp_in == UART_DEBUG_BUFFER_SIZE) temp_in -= UART_DEBUG_BUFFER_SIZE;
-#ifdef UART_DEBUG_WAIT_TILL_SEND
-        // wait till room is available
-        while (temp_in == debug_buffer.out) {
-            Nop();
-        }
-#else
-        if (temp_in == debug_buffer.out) {
-            break;              // No more room is available in the buffer
-        }
-#endif
-        debug_buffer.data[debug_buffer.in] = *str;
-        debug_buffer.in++;
-        str++;
-        if (debug_buffer.in == UART_DEBUG_BUFFER_SIZE) debug_buffer.in = 0;
+    debug_put16(&frame[size], utl_calc_crc(frame, size));
+    size += DEBUG_FRAME_CRC_SIZE;
+    encoded[0] = 0x00;
+    encoded_size = utl_cobs_encode(frame, size, &encoded[1]) + 1;
+    encoded[encoded_size++] = 0x00;
+    // Only send complete frames, a frame is reserved whole or not at all
+    if (policy != UART_DEBUG_BLOCK) {
+        policy = UART_DEBUG_DROP_MESSAGE;
     }
+    if (debug_reserve_policy(lane, encoded_size, &span, policy) != 0) {
+        debug_copy(&span, (const char *)encoded);
+        debug_commit(&span);
+    }
+}
+
+/**
+ * Function prototype:  static void debug_send_record(void)
+ * Description:         Sends all telemetry values as one binary record
+ */
+static void debug_send_record(void){
+    uint8_t frame[DEBUG_FRAME_SIZE];
     
-    
-    _U2TXIE = 0;                  // disable interrupt
-    // Fill the buffer till full or no more character are available
-    // Needs to be done to trigger the start of the interrupts
-	while (!U2STAbits.UTXBF && (debug_buffer.in != debug_buffer.out)) {
-		// Write character to transmit buffer
-		U2TXREG = debug_buffer.data[debug_buffer.out++];
-        if (debug_buffer.out == UART_DEBUG_BUFFER_SIZE) debug_buffer.out = 0;
-	}
-    _U2TXIE = 1;                  // enable interrupt
+    frame[0] = DEBUG_FRAME_TYPE_RECORD;
+    frame[1] = debug_record_sequence++;
+    debug_record_fill((debug_record_t *)&frame[DEBUG_FRAME_HEADER_SIZE]);
+    debug_send_frame(UART_DEBUG_LANE_TELEMETRY, frame, DEBUG_FRAME_HEADER_SIZE + DEBUG_RECORD_SIZE);
 }
 
 /**
- * Function prototype:  void debug_char(char value)
- * Description:         Prints an char to the uart port
+ * Function prototype:  static uint8_t debug_put_varint(uint8_t *field, uint32_t value)
+ * Description:         Writes value as an unsigned LEB128 number, returns the number of bytes
  */
-void debug_char(char value){
-    char temp_str[2] = " \0";
-    // Convert the value to a string
-    temp_str[0] = value;
-    // Put the string in the buffer
-    debug_string(temp_str);
+static uint8_t debug_put_varint(uint8_t *field, uint32_t value){
+    uint8_t len = 0;
+    
+    while (value >= 0x80) {
+        field[len++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    field[len++] = (uint8_t)value;
+    return len;
 }
 
 /**
- * Function prototype:  void debug_uint(uint32_ value)
- * Description:         Prints an unsigned integer to the uart port
+ * Function prototype:  static void debug_trace_lane(uint8_t lane, const char *prefix, uint8_t id, const uint32_t *args, uint8_t count)
+ * Description:         Sends a trace message as id and arguments, or formats it outside trace mode
  */
-void debug_uint(uint32_t value){
-    char temp_str[16];
-    // Convert the value to a string
-    utl_ui32toa(value, temp_str, 10);
-    // Put the string in the buffer
-    debug_string(temp_str);
+static void debug_trace_lane(uint8_t lane, const char *prefix, uint8_t id, const uint32_t *args, uint8_t count){
+    uint8_t frame[DEBUG_TRACE_FRAME_SIZE(DEBUG_TRACE_MAX_ARGS)];
+    uint32_t value[DEBUG_TRACE_MAX_ARGS];
+    uint8_t i, size;
+    
+    if (id >= DEBUG_TRACE_COUNT) {
+        return;
+    }
+    if (count > DEBUG_TRACE_MAX_ARGS) {
+        count = DEBUG_TRACE_MAX_ARGS;
+    }
+    if (debug_mode == UART_DEBUG_MODE_TRACE) {
+        frame[0] = DEBUG_FRAME_TYPE_TRACE;
+        frame[1] = id;
+        size = DEBUG_FRAME_HEADER_SIZE;
+        for (i = 0; i < count; i++) {
+            size += debug_put_varint(&frame[size], args[i]);
+        }
+        debug_send_frame(lane, frame, size);
+    } else {
+        // Unused arguments are never read by the format, pass them as 0
+        for (i = 0; i < DEBUG_TRACE_MAX_ARGS; i++) {
+            value[i] = (i < count) ? args[i] : 0;
+        }
+        debug_printf_prefix(lane, prefix, debug_trace_format[id], value[0], value[1], value[2], value[3],
+                            value[4], value[5], value[6], value[7], value[8], value[9]);
+    }
 }
 
 /**
- * Function prototype:  void debug_int(int32_t value)
- * Description:         Prints an integer to the uart port
+ * Function prototype:  void debug_trace(uint8_t id, const uint32_t *args, uint8_t count)
+ * Description:         Sends a trace message in the event lane
  */
-void debug_int(int32_t value){
-    char temp_str[16];
-    // Convert the value to a string
-    utl_i32toa(value, temp_str, 10);
-    // Put the string in the buffer
-    debug_string(temp_str);
+void debug_trace(uint8_t id, const uint32_t *args, uint8_t count){
+    debug_trace_lane(UART_DEBUG_LANE_EVENT, NULL, id, args, count);
 }
 
-void debug_int_len(int32_t value, uint8_t len){
-    char temp_str[16];
-    // Convert the value to a string
-    utl_i32toa_l(value, temp_str, 10, len);
-    // Put the string in the buffer
-    debug_string(temp_str);
+// Getters of the timed debug fields, each fills the arguments of its trace message
+static uint8_t debug_get_ecu_state(uint32_t *args){
+    args[0] = get_ecu_state();
+    args[1] = get_ecu_mode();
+    return 2;
 }
 
-/**
- * Function prototype:  void debug_hex(uint32_t value)
- * Description:         Prints an unsigned integer as a hex string to the uart port
- */
-void debug_hex(uint32_t value){
-    char temp_str[16];
-    // Convert the value to a string
-    utl_ui32toa(value, temp_str, 16);
-    // Put the string in the buffer
-    debug_string(temp_str);
+static uint8_t debug_get_button(uint32_t *args){
+    args[0] = get_user_interface_button_state(BUTTON_LOCAL_ROM_START_STOP, BUTTON_DOWN);
+    args[1] = get_user_interface_button_state(BUTTON_LOCAL_ROM_MODE, BUTTON_DOWN);
+    args[2] = get_user_interface_button_state(SWITCH_LOCAL_ROM_LOCAL, BUTTON_DOWN);
+    args[3] = get_user_interface_button_state(SWITCH_LOCAL_ROM_REMOTE, BUTTON_DOWN);
+    args[4] = get_user_interface_button_state(BUTTON_REMOTE_ROM_START_STOP, BUTTON_DOWN);
+    return 5;
+}
+
+static uint8_t debug_get_dig_sensor(uint32_t *args){
+    args[0] = get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_1);
+    args[1] = get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_2);
+    args[2] = get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_3);
+    args[3] = get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_4);
+    args[4] = get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_1);
+    args[5] = get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_2);
+    args[6] = get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_3);
+    args[7] = get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_4);
+    args[8] = get_sensor_alt_feedback_is_activated();
+    return 9;
+}
+
+static uint8_t debug_get_e_stop(uint32_t *args){
+    args[0] = get_sensor_e_stop_is_closed();
+    args[1] = get_sensor_e_stop_is_activated();
+    return 2;
+}
+
+static uint8_t debug_get_analog_sensor(uint32_t *args){
+    //args[0] = get_sensor_analog_value(SENSOR_ANALOG_INPUT_1);
+    args[0] = get_sensor_pic_engine_analog_sensor_raw(SENSOR_PIC_COM_AN_SENSOR_1);
+    //args[1] = get_sensor_analog_value(SENSOR_ANALOG_INPUT_2);
+    args[1] = get_sensor_pic_engine_analog_sensor_raw(SENSOR_PIC_COM_AN_SENSOR_2);
+    args[2] = get_userio_analog_input_value();
+    args[3] = get_adc1_raw_value(ADC1_RESULT_USER_SENSOR);
+    return 4;
+}
+
+static uint8_t debug_get_pt100(uint32_t *args){
+    args[0] = get_sensor_pic_pt100_temperature_raw(1);
+    args[1] = get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_1);
+    args[2] = get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_2);
+    args[3] = get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_3);
+    return 4;
+}
+
+static uint8_t debug_get_battery(uint32_t *args){
+    args[0] = get_sensor_battery_voltage_mv();
+    args[1] = get_adc1_raw_value(ADC1_RESULT_BATT_SENSE);
+    return 2;
 }
 
+static uint8_t debug_get_generator_v(uint32_t *args){
+    args[0] = get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_1);
+    args[1] = get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_2);
+    args[2] = get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_3);
+    return 3;
+}
+
+static uint8_t debug_get_generator_a(uint32_t *args){
+    args[0] = get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_1);
+    args[1] = get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_2);
+    args[2] = get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_3);
+    return 3;
+}
+
+static uint8_t debug_get_generator_va(uint32_t *args){
+    args[0] = get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_1);
+    args[1] = get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_2);
+    args[2] = get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_3);
+    return 3;
+}
+
+static uint8_t debug_get_generator(uint32_t *args){
+    args[0] = get_generator_measure_voltage_freq_10mhz();
+    args[1] = get_generator_measure_rpm();
+    args[2] = get_generator_measure_total_power_va();
+    return 3;
+}
+
+static uint8_t debug_get_sensor_alarm(uint32_t *args){
+    args[0] = get_alarms_state(ALARM_SENSOR_DIGITAL_1);
+    args[1] = get_alarms_state(ALARM_SENSOR_DIGITAL_2);
+    args[2] = get_alarms_state(ALARM_SENSOR_DIGITAL_3);
+    args[3] = get_alarms_state(ALARM_SENSOR_DIGITAL_4);
+    args[4] = get_alarms_state(ALARM_SENSOR_ANALOG_1);
+    args[5] = get_alarms_state(ALARM_SENSOR_ANALOG_2);
+    return 6;
+}
+
+static uint8_t debug_get_generator_alarm(uint32_t *args){
+    args[0] = get_alarms_state(ALARM_GENERATOR_LOW_VOLTAGE_1);
+    args[1] = get_alarms_state(ALARM_GENERATOR_LOW_VOLTAGE_2);
+    args[2] = get_alarms_state(ALARM_GENERATOR_HIGH_VOLTAGE_1);
+    args[3] = get_alarms_state(ALARM_GENERATOR_HIGH_VOLTAGE_2);
+    args[4] = get_alarms_state(ALARM_GENERATOR_HIGH_CURRENT_1);
+    args[5] = get_alarms_state(ALARM_GENERATOR_HIGH_CURRENT_2);
+    args[6] = get_alarms_state(ALARM_GENERATOR_HIGH_POWER_1);
+    args[7] = get_alarms_state(ALARM_GENERATOR_HIGH_POWER_2);
+    return 8;
+}
+
+static uint8_t debug_get_engine_alarm(uint32_t *args){
+    args[0] = get_alarms_state(ALARM_BATTERY_LOW_VOLTAGE);
+    args[1] = get_alarms_state(ALARM_BATTERY_FAILED_TO_CHARGE);
+    args[2] = get_alarms_state(ALARM_ENGINE_LOW_RPM_1);
+    args[3] = get_alarms_state(ALARM_ENGINE_LOW_RPM_2);
+    args[4] = get_alarms_state(ALARM_ENGINE_HIGH_RPM_1);
+    args[5] = get_alarms_state(ALARM_ENGINE_HIGH_RPM_1);
+    return 6;
+}
+
+static uint8_t debug_get_ecu_alarm(uint32_t *args){
+    args[0] = get_alarms_state(ALARM_GENERIC_FAILED_TO_START);
+    args[1] = get_alarms_state(ALARM_GENERIC_FAILED_TO_STOP);
+    args[2] = get_alarms_state(ALARM_GENERIC_E_STOP);
+    args[3] = get_alarms_state(ALARM_GENERIC_MAINTENANCE);
+    args[4] = get_alarms_state(ALARM_GENERIC_USER_DIG_1);
+    args[5] = get_alarms_state(ALARM_GENERIC_USER_DIG_2);
+    args[6] = get_alarms_state(ALARM_GENERIC_USER_AN);
+    return 7;
+}
+
+static uint8_t debug_get_pic_com_state(uint32_t *args){
+    args[0] = get_sensor_pic_com_state();
+    return 1;
+}
+
+#ifdef UART_DEBUG_STATS
+static uint8_t debug_get_debug_buffer(uint32_t *args){
+    debug_stats_t stats;
+    
+    debug_get_stats(&stats);
+    args[0] = stats.max_used[UART_DEBUG_LANE_ALARM];
+    args[1] = stats.max_used[UART_DEBUG_LANE_EVENT];
+    args[2] = stats.max_used[UART_DEBUG_LANE_TELEMETRY];
+    return 3;
+}
+
+static uint8_t debug_get_debug_queue(uint32_t *args){
+    debug_stats_t stats;
+    
+    debug_get_stats(&stats);
+    args[0] = stats.bytes_queued;
+    args[1] = stats.bytes_sent;
+    args[2] = stats.dropped_bytes;
+    args[3] = stats.dropped_messages;
+    return 4;
+}
+
+static uint8_t debug_get_debug_cycles(uint32_t *args){
+    debug_stats_t stats;
+    
+    debug_get_stats(&stats);
+    args[0] = stats.isr_count;
+    args[1] = stats.isr_cycles;
+    args[2] = stats.producer_count;
+    args[3] = stats.producer_cycles;
+    return 4;
+}
+
+static uint8_t debug_get_debug_alarm(uint32_t *args){
+    debug_stats_t stats;
+    
+    debug_get_stats(&stats);
+    args[0] = stats.alarm_count;
+    args[1] = stats.alarm_wait_max;
+    args[2] = stats.alarm_wait;
+    return 3;
+}
+#endif
+
+/*
+static void debug_send_rtcc(void){
+    static utl_datetime_t datetime = {"0000-00-00 00:00:00", 0xFFFFFFFFUL, 0xFFFF};
+    rtcc_timestamp_t rtcc_timestamp;
+    
+    rtcc_timestamp = get_rtcc_timestamp();
+    debug_string((char *)utl_datetime(&datetime, 2000 + rtcc_timestamp.year, rtcc_timestamp.month, rtcc_timestamp.day,
+                                      rtcc_timestamp.hour, rtcc_timestamp.min, rtcc_timestamp.sec));
+    debug_string("\r\n");
+    
+    if (get_rtcc_backup_battery_good()) {
+        debug_string("RTCC backup battery ok\r\n");
+    } else {
+        debug_string("RTCC backup battery fail\r\n");
+    }
+}*/
+
+// Timed debug fields, sent in this order when several are due in the same tick, at most 32.
+// DEBUG_FIELD(trace, period, getter, deadband, values), values is the number of arguments of the getter.
+#ifdef UART_DEBUG_STATS
+#define DEBUG_STATS_FIELDS \
+    DEBUG_FIELD(TRACE_DEBUG_BUFFER,     DEBUG_PERIOD_MS(10000), debug_get_debug_buffer,     0,  3) \
+    DEBUG_FIELD(TRACE_DEBUG_QUEUE,      DEBUG_PERIOD_MS(10000), debug_get_debug_queue,      0,  4) \
+    DEBUG_FIELD(TRACE_DEBUG_CYCLES,     DEBUG_PERIOD_MS(10000), debug_get_debug_cycles,     0,  4) \
+    DEBUG_FIELD(TRACE_DEBUG_ALARM,      DEBUG_PERIOD_MS(10000), debug_get_debug_alarm,      0,  3)
+#else
+#define DEBUG_STATS_FIELDS
+#endif
+#define DEBUG_FIELDS \
+    DEBUG_FIELD(DEBUG_FIELD_ECU_STATE,  DEBUG_PERIOD_MS(1000),  debug_get_ecu_state,        0,  2) \
+    DEBUG_FIELD(TRACE_SENSOR_ALARM,     DEBUG_PERIOD_MS(100),   debug_get_sensor_alarm,     0,  6) \
+    DEBUG_FIELD(TRACE_GENERATOR_ALARM,  DEBUG_PERIOD_MS(100),   debug_get_generator_alarm,  0,  8) \
+    DEBUG_FIELD(TRACE_ENGINE_ALARM,     DEBUG_PERIOD_MS(100),   debug_get_engine_alarm,     0,  6) \
+    DEBUG_FIELD(TRACE_ECU_ALARM,        DEBUG_PERIOD_MS(100),   debug_get_ecu_alarm,        0,  7) \
+    DEBUG_FIELD(TRACE_GENERATOR_V,      DEBUG_PERIOD_MS(500),   debug_get_generator_v,      5,  3)  /* 0.5 V */ \
+    DEBUG_FIELD(TRACE_GENERATOR_A,      DEBUG_PERIOD_MS(500),   debug_get_generator_a,      1,  3)  /* 0.1 A */ \
+    DEBUG_FIELD(TRACE_GENERATOR_VA,     DEBUG_PERIOD_MS(500),   debug_get_generator_va,     50, 3) \
+    DEBUG_FIELD(TRACE_GENERATOR,        DEBUG_PERIOD_MS(500),   debug_get_generator,        5,  3)  /* 0.05 Hz, 5 RPM, 5 VA */ \
+    DEBUG_FIELD(TRACE_BUTTON,           DEBUG_PERIOD_MS(1000),  debug_get_button,           0,  5) \
+    DEBUG_FIELD(TRACE_DIG_SENSOR,       DEBUG_PERIOD_MS(1000),  debug_get_dig_sensor,       0,  9) \
+    DEBUG_FIELD(TRACE_E_STOP,           DEBUG_PERIOD_MS(1000),  debug_get_e_stop,           0,  2) \
+    DEBUG_FIELD(TRACE_ANALOG_SENSOR,    DEBUG_PERIOD_MS(1000),  debug_get_analog_sensor,    4,  4)  /* Raw adc counts */ \
+    DEBUG_FIELD(TRACE_PT100,            DEBUG_PERIOD_MS(1000),  debug_get_pt100,            5,  4)  /* 0.5 degree */ \
+    DEBUG_FIELD(TRACE_PIC_COM_STATE,    DEBUG_PERIOD_MS(1000),  debug_get_pic_com_state,    0,  1) \
+    DEBUG_FIELD(TRACE_BATTERY,          DEBUG_PERIOD_MS(10000), debug_get_battery,          50, 2)  /* 50 mV */ \
+    DEBUG_STATS_FIELDS
+
+#define DEBUG_FIELD(trace, period, get, deadband, values)   {trace, period, get, deadband},
+static const debug_field_t debug_fields[] = {
+    DEBUG_FIELDS
+};
+#undef DEBUG_FIELD
+#define DEBUG_FIELD_COUNT   (sizeof(debug_fields) / sizeof(debug_fields[0]))
+
+// Arguments of all fields together, the size of the snapshot of a tick
+#define DEBUG_FIELD(trace, period, get, deadband, values)   + (values)
+enum { DEBUG_SNAPSHOT_VALUES = 0 DEBUG_FIELDS };
+#undef DEBUG_FIELD
+// The snapshot offsets are 8 bit, the array size is negative when the values do not fit
+typedef char debug_snapshot_fits[(DEBUG_SNAPSHOT_VALUES <= 255) ? 1 : -1];
+
+// Run time settings of the timed debug fields, changed with debug_command
+static uint8_t debug_field_period[DEBUG_FIELD_COUNT];       // Period in ticks, from debug_fields
+static uint8_t debug_field_countdown[DEBUG_FIELD_COUNT];    // Ticks till a field is due again
+static uint32_t debug_field_off = 0;                        // Bit n stops debug_fields[n]
+static uint8_t debug_tick_timers = 1;                       // Timer periods per tick
+
+// Values of the fields of a tick, all read in the same call of debug_process.
+// The lines are sent from here, so the lines of one tick show the same moment.
+static struct{
+    uint32_t values[DEBUG_SNAPSHOT_VALUES];
+    uint8_t offset[DEBUG_FIELD_COUNT];      // First value of a field
+    uint8_t count[DEBUG_FIELD_COUNT];       // Number of values of a field
+} debug_snapshot;
+
+// Names of the ECU states and modes, in place of a getter call per compare
+static const debug_name_t debug_ecu_state_names[] = {
+    {OFF, "OFF"}, {IDLE, "IDLE"}, {PUMPING, "PUMP"}, {GLOWING, "GLOW"}, {CRANKING, "START"},
+    {START_DELAY, "START_DELAY"}, {SAFETY_ON_DELAY, "PRERUNNING"}, {RUNNING, "RUNNING"},
+    {STOPPING, "STOPPING"}, {ALARM, "ALARM"}
+};
+static const debug_name_t debug_ecu_mode_names[] = {
+    {LOCAL_ONLY, "LOCAL_ONLY"}, {MANUAL, "MANUAL"}, {AUTOMATIC, "AUTOMATIC"}
+};
+#define DEBUG_NAME_COUNT(names)     (sizeof(names) / sizeof(names[0]))
+
 /**
  * Function prototype:  void debug_uart_init(void)
  * Description:         Configures the UART2 peripheral for debug output
  */
 void debug_uart_init(void){
+    uint8_t field;
+#if defined(__XC16__)
     uint32_t brg_value;
+#endif
     
+#ifdef UART_DEBUG_COMPRESS
+    debug_compress_init();
+#endif
+#ifdef UART_DEBUG_TIMESTAMPS
+    utl_datetime_init(&debug_datetime);
+#endif
+#if defined(__XC16__)
 	//setup pin mapping
 	//uart tx - pin 48 - RP79,RD15
 	//uart rx - pin 47 - RP78,RD14
@@ -177,290 +1657,490 @@ void debug_uart_init(void){
     _U2TXIP = 3;                    //Interrupt priority of 3. (0 is lowest and 7 is highest)
     _U2TXIF = 0;                    //Clear UART TX interrupt flags
     _U2TXIE = 1;                    //Enable UART TX interrupt
+#ifdef UART_DEBUG_COMMANDS
+    U2STAbits.URXISEL = 0b00;       //Interrupt when a character is received
+    _U2RXIP = 3;                    //Interrupt priority of 3, same as transmit
+    _U2RXIF = 0;                    //Clear UART RX interrupt flags
+    _U2RXIE = 1;                    //Enable UART RX interrupt
+#endif
     
     U2MODEbits.UARTEN  = 1;         //UARTx is enabled; all UARTx pins are controlled by UARTx as defined by UEN<1:0>
     U2STAbits.UTXEN = 1;            //Transmit is enabled, UxTX pin is controlled by UARTx
+#else
+    //Emulated uart with the same fifo, rate and interrupt, see tools/host
+    debug_host_uart_init(UART_DEBUG_DATA_RATE);
+#endif
     
-    //Init one second timer
-    debug_timer = software_timer_create(SOFTWARE_TIMER_MODE_CONTINUOUS, 1000);
+    //Init the tick timer of the timed debug messages
+    for (field = 0; field < DEBUG_FIELD_COUNT; field++) {
+        debug_field_period[field] = debug_fields[field].period;
+    }
+    debug_timer = software_timer_create(SOFTWARE_TIMER_MODE_CONTINUOUS, UART_DEBUG_TICK_MS);
     software_timer_start(debug_timer);
+    //Init binary record timer
+    debug_record_timer = software_timer_create(SOFTWARE_TIMER_MODE_CONTINUOUS, UART_DEBUG_RECORD_PERIOD_MS);
+    software_timer_start(debug_record_timer);
     //debug_timer = SOFTWARE_TIMER_NO_TIMER;
 }
 
+/**
+ * Function prototype:  static const char *debug_name(const debug_name_t *names, uint8_t count, uint8_t value)
+ * Description:         Looks up the name of a state, returns "" for an unknown state
+ */
+static const char *debug_name(const debug_name_t *names, uint8_t count, uint8_t value){
+    uint8_t i;
+    
+    for (i = 0; i < count; i++) {
+        if (names[i].value == value) {
+            return names[i].name;
+        }
+    }
+    return "";
+}
+
+/**
+ * Function prototype:  static void debug_send_ecu_state(const uint32_t *args)
+ * Description:         Prints the ECU state line, args holds the state and the mode.
+ *                      The empty line in front of it ends the previous block of lines,
+ *                      so every block starts with the state (and the time).
+ */
+static void debug_send_ecu_state(const uint32_t *args){
+    const char *state, *mode;
+    
+    state = debug_name(debug_ecu_state_names, DEBUG_NAME_COUNT(debug_ecu_state_names), (uint8_t)args[0]);
+    mode = debug_name(debug_ecu_mode_names, DEBUG_NAME_COUNT(debug_ecu_mode_names), (uint8_t)args[1]);
+#ifdef UART_DEBUG_TIMESTAMPS
+    debug_printf_lane(UART_DEBUG_LANE_TELEMETRY, "\r\n%s %s %s\r\n", debug_datetime.text, state, mode);
+#else
+    debug_printf_lane(UART_DEBUG_LANE_TELEMETRY, "\r\n%s %s\r\n", state, mode);
+#endif
+}
+
+/**
+ * Function prototype:  static uint32_t debug_snapshot_take(uint32_t fields)
+ * Description:         Reads the values of the fields in one go. Returns the fields that
+ *                      were read. A getter that returns more values than debug_fields
+ *                      says is left out and counted as a dropped message.
+ */
+static uint32_t debug_snapshot_take(uint32_t fields){
+    uint32_t args[DEBUG_TRACE_MAX_ARGS];
+    uint8_t field, count, used = 0;
+#ifdef UART_DEBUG_TIMESTAMPS
+    rtcc_timestamp_t timestamp;
+    
+    // The time of the snapshot, only the fields that changed are formatted again
+    timestamp = get_rtcc_timestamp();
+    utl_datetime(&debug_datetime, 2000 + timestamp.year, timestamp.month, timestamp.day,
+                 timestamp.hour, timestamp.min, timestamp.sec);
+#endif
+    
+    for (field = 0; field < DEBUG_FIELD_COUNT; field++) {
+        if ((fields & (1UL << field)) == 0) {
+            continue;
+        }
+        count = debug_fields[field].get(args);
+        if (count > DEBUG_SNAPSHOT_VALUES - used) {
+            fields &= ~(1UL << field);
+            debug_count_drop(0, 1);
+            continue;
+        }
+        memcpy(&debug_snapshot.values[used], args, count * sizeof(uint32_t));
+        debug_snapshot.offset[field] = used;
+        debug_snapshot.count[field] = count;
+        used += count;
+    }
+    return fields;
+}
+
+#ifdef UART_DEBUG_DELTA_MESSAGES
+// Values of the last line sent per field, and the fields that must be sent on their next turn
+static uint32_t debug_field_last[DEBUG_FIELD_COUNT][DEBUG_TRACE_MAX_ARGS];
+static uint32_t debug_field_keyframe = 0;
+
+/**
+ * Function prototype:  static uint8_t debug_field_changed(uint8_t field, const uint32_t *args, uint8_t count)
+ * Description:         Returns 1 when a value moved more than the deadband since the last line
+ *                      that was sent, or a keyframe is due. The values are then kept as sent.
+ */
+static uint8_t debug_field_changed(uint8_t field, const uint32_t *args, uint8_t count){
+    uint32_t *last = debug_field_last[field];
+    int32_t change;
+    uint8_t i;
+    
+    if ((debug_field_keyframe & (1UL << field)) == 0) {
+        for (i = 0; i < count; i++) {
+            // Signed difference, some values are negative numbers in 32 bits
+            change = (int32_t)(args[i] - last[i]);
+            if (change > (int32_t)debug_fields[field].deadband || change < -(int32_t)debug_fields[field].deadband) {
+                break;
+            }
+        }
+        if (i == count) {
+            return 0;
+        }
+    }
+    debug_field_keyframe &= ~(1UL << field);
+    memcpy(last, args, count * sizeof(uint32_t));
+    return 1;
+}
+#endif
+
+#ifdef UART_DEBUG_COMMANDS
+// Names of the trace messages, the commands use them without the TRACE_ prefix
+#define DEBUG_TRACE_MESSAGE(id, format)     #id,
+static const char * const debug_trace_name[DEBUG_TRACE_COUNT] = {
+    DEBUG_TRACE_MESSAGES
+};
+#undef DEBUG_TRACE_MESSAGE
+#define DEBUG_TRACE_NAME_PREFIX     (sizeof("TRACE_") - 1)
+
+#define DEBUG_COMMAND_MAX_WORDS     3
+#define DEBUG_COMMAND_SKIP          0xFF    // Line length while the rest of a bad line is skipped
+
+// Complete lines waiting to run, each after its length (0 for a bad line), then the line being received
+static char debug_command_line[UART_DEBUG_COMMAND_BUFFER];
+static uint8_t debug_command_waiting = 0;      // Bytes of the complete lines
+static uint8_t debug_command_length = 0;       // Length of the line being received
+static debug_stream_t debug_command_reply;     // Replies longer than one line
+
+/**
+ * Function prototype:  static const char *debug_field_name(uint8_t field)
+ * Description:         Returns the name of a timed debug field, as used by the commands
+ */
+static const char *debug_field_name(uint8_t field){
+    if (debug_fields[field].trace == DEBUG_FIELD_ECU_STATE) {
+        return "ECU_STATE";
+    }
+    return debug_trace_name[debug_fields[field].trace] + DEBUG_TRACE_NAME_PREFIX;
+}
+
+/**
+ * Function prototype:  static uint8_t debug_command_lines(const debug_stream_t *stream, char *str, uint8_t size)
+ * Description:         Formats a line of the "lines" reply: number, name, period and state of a field
+ */
+static uint8_t debug_command_lines(const debug_stream_t *stream, char *str, uint8_t size){
+    uint8_t field = (uint8_t)stream->index;
+    
+    if (stream->index >= DEBUG_FIELD_COUNT) {
+        return 0;
+    }
+    return (uint8_t)utl_snprintf(str, size, "Line %u %s %lu ms%s\r\n", field, debug_field_name(field),
+                                 (uint32_t)debug_field_period[field] * debug_tick_timers * UART_DEBUG_TICK_MS,
+                                 (debug_field_off & (1UL << field)) ? " off" : "");
+}
+
+/**
+ * Function prototype:  static uint8_t debug_word_is(const char *word, uint8_t len, const char *name)
+ * Description:         Compares a word of a command line to a name, case insensitive
+ */
+static uint8_t debug_word_is(const char *word, uint8_t len, const char *name){
+    uint8_t i;
+    
+    for (i = 0; i < len; i++) {
+        // Upper and lower case letters only differ in bit 5
+        if (name[i] == '\0' || (word[i] | 0x20) != (name[i] | 0x20)) {
+            return 0;
+        }
+    }
+    return name[len] == '\0';
+}
+
+/**
+ * Function prototype:  static uint8_t debug_word_number(const char *word, uint8_t len, uint32_t *value)
+ * Description:         Reads a word that is a decimal number, returns 0 when it is not one
+ */
+static uint8_t debug_word_number(const char *word, uint8_t len, uint32_t *value){
+    uint8_t status;
+    
+    return utl_parse_u32(word, len, 10, value, &status) == word + len && status == UTL_PARSE_OK;
+}
+
+/**
+ * Function prototype:  static uint32_t debug_word_fields(const char *word, uint8_t len)
+ * Description:         Returns the fields a word selects, bit n is debug_fields[n].
+ *                      The word is "all", the number of a field or its name.
+ */
+static uint32_t debug_word_fields(const char *word, uint8_t len){
+    uint32_t value;
+    uint8_t field;
+    
+    if (debug_word_is(word, len, "all")) {
+        return 0xFFFFFFFFUL >> (32 - DEBUG_FIELD_COUNT);
+    }
+    if (debug_word_number(word, len, &value)) {
+        return (value < DEBUG_FIELD_COUNT) ? 1UL << value : 0;
+    }
+    for (field = 0; field < DEBUG_FIELD_COUNT; field++) {
+        if (debug_word_is(word, len, debug_field_name(field))) {
+            return 1UL << field;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Function prototype:  uint8_t debug_command(const char *line, uint8_t length)
+ * Description:         Runs a command line and prints the reply, see uart_debug.h
+ */
+uint8_t debug_command(const char *line, uint8_t length){
+    const char *word[DEBUG_COMMAND_MAX_WORDS];
+    uint8_t len[DEBUG_COMMAND_MAX_WORDS];
+    uint8_t words = 0, done = 0, i, field;
+    uint32_t fields = 0, value;
+    debug_stats_t stats;
+    
+    // Split the line in words
+    for (i = 0; i < length; i++) {
+        if (line[i] == ' ' || line[i] == '\t') {
+            continue;
+        }
+        if (words == DEBUG_COMMAND_MAX_WORDS) {
+            words = 0;              // No command has this many words
+            break;
+        }
+        word[words] = &line[i];
+        while (i < length && line[i] != ' ' && line[i] != '\t') {
+            i++;
+        }
+        len[words] = (uint8_t)(&line[i] - word[words]);
+        words++;
+    }
+    if (words >= 2) {
+        fields = debug_word_fields(word[1], len[1]);
+    }
+    
+    if (words == 1 && debug_word_is(word[0], len[0], "lines")) {
+        // Sent by debug_process as room frees up
+        debug_stream_start(&debug_command_reply, UART_DEBUG_LANE_EVENT, debug_command_lines, 0, DEBUG_FIELD_COUNT);
+        return 1;
+    } else if (words == 1 && debug_word_is(word[0], len[0], "stats")) {
+        debug_get_stats(&stats);
+        debug_printf("Stats: tx %lu q %lu drop %lu %lu\r\n", stats.bytes_sent, stats.bytes_queued,
+                     stats.dropped_bytes, stats.dropped_messages);
+        debug_printf("Stats: max %lu %lu %lu\r\n", (uint32_t)stats.max_used[UART_DEBUG_LANE_ALARM],
+                     (uint32_t)stats.max_used[UART_DEBUG_LANE_EVENT], (uint32_t)stats.max_used[UART_DEBUG_LANE_TELEMETRY]);
+        debug_printf("Stats: isr %lu %lu prod %lu %lu\r\n", stats.isr_count, stats.isr_cycles,
+                     stats.producer_count, stats.producer_cycles);
+        debug_printf("Stats: alarm %lu wait max %lu sum %lu\r\n", stats.alarm_count, stats.alarm_wait_max,
+                     stats.alarm_wait);
+        return 1;
+    } else if (words == 2 && fields != 0 && debug_word_is(word[0], len[0], "on")) {
+        debug_field_off &= ~fields;
+        done = 1;
+    } else if (words == 2 && fields != 0 && debug_word_is(word[0], len[0], "off")) {
+        debug_field_off |= fields;
+        done = 1;
+    } else if (words == 3 && fields != 0 && debug_word_is(word[0], len[0], "rate") &&
+               debug_word_number(word[2], len[2], &value)) {
+        // Milliseconds to ticks, rounded down
+        value /= (uint32_t)UART_DEBUG_TICK_MS * debug_tick_timers;
+        if (value != 0 && value <= 255) {
+            for (field = 0; field < DEBUG_FIELD_COUNT; field++) {
+                if (fields & (1UL << field)) {
+                    debug_field_period[field] = (uint8_t)value;
+                    debug_field_countdown[field] = 0;       // Due on the next tick
+                }
+            }
+            done = 1;
+        }
+    } else if (words == 2 && debug_word_is(word[0], len[0], "tick") && debug_word_number(word[1], len[1], &value)) {
+        // Whole timer periods, the periods of all fields scale with it
+        value /= UART_DEBUG_TICK_MS;
+        if (value != 0 && value <= 255) {
+            debug_tick_timers = (uint8_t)value;
+            done = 1;
+        }
+    } else if (words == 2 && debug_word_is(word[0], len[0], "mode")) {
+        done = 1;
+        if (debug_word_is(word[1], len[1], "ascii")) {
+            debug_set_mode(UART_DEBUG_MODE_ASCII);
+        } else if (debug_word_is(word[1], len[1], "binary")) {
+            debug_set_mode(UART_DEBUG_MODE_BINARY);
+        } else if (debug_word_is(word[1], len[1], "trace")) {
+            debug_set_mode(UART_DEBUG_MODE_TRACE);
+        } else {
+            done = 0;
+        }
+    }
+    debug_string(done ? "OK\r\n" : "ERR\r\n");
+    return done;
+}
+
+/**
+ * Function prototype:  static void debug_command_poll(void)
+ * Description:         Collects the received characters in lines, also while a long reply
+ *                      is sent, and runs the first complete line once no reply is sent.
+ *                      One command per call, so its reply finds room in the buffer.
+ */
+static void debug_command_poll(void){
+    uint8_t out, length, streaming;
+    char c;
+    
+    streaming = debug_stream_process(&debug_command_reply);
+    if (debug_atomic_load(&debug_rx.lost)) {
+        // Characters are missing, the line is not run
+        debug_atomic_store(&debug_rx.lost, 0);
+        debug_command_length = DEBUG_COMMAND_SKIP;
+    }
+    out = debug_atomic_load(&debug_rx.out);
+    while (out != debug_atomic_load(&debug_rx.in) && debug_command_waiting < UART_DEBUG_COMMAND_BUFFER) {
+        c = debug_rx.data[out & UART_DEBUG_RX_BUFFER_MASK];
+        if (c == '\r' || c == '\n') {
+            // Empty lines, like the \n of \r\n, are ignored
+            if (debug_command_length == DEBUG_COMMAND_SKIP) {
+                debug_command_line[debug_command_waiting++] = 0;
+                debug_command_length = 0;
+            } else if (debug_command_length != 0) {
+                debug_command_line[debug_command_waiting] = (char)debug_command_length;
+                debug_command_waiting += debug_command_length + 1;
+                debug_command_length = 0;
+            }
+        } else if (debug_command_length == DEBUG_COMMAND_SKIP) {
+            // Rest of a bad line
+        } else if (c == '\b' || c == 0x7F) {
+            // Backspace or delete of a terminal
+            if (debug_command_length != 0) {
+                debug_command_length--;
+            }
+        } else if (debug_command_length >= UART_DEBUG_COMMAND_LENGTH) {
+            debug_command_length = DEBUG_COMMAND_SKIP;
+        } else if (debug_command_waiting + debug_command_length + 1 >= UART_DEBUG_COMMAND_BUFFER) {
+            break;                  // The character stays in rx till the waiting lines have run
+        } else {
+            debug_command_line[debug_command_waiting + 1 + debug_command_length++] = c;
+        }
+        out++;
+        debug_atomic_store(&debug_rx.out, out);
+    }
+    if (streaming || debug_command_waiting == 0) {
+        return;                     // New commands wait till the reply is sent
+    }
+    length = (uint8_t)debug_command_line[0];
+    if (length == 0) {
+        debug_string("ERR\r\n");
+    } else {
+        debug_command(&debug_command_line[1], length);
+    }
+    length++;
+    debug_command_waiting -= length;
+    memmove(debug_command_line, &debug_command_line[length], UART_DEBUG_COMMAND_BUFFER - length);
+}
+#endif
+
 /**
  * Function prototype:  void debug_process(void)
- * Description:         Prints predefined debug data to the uart every second.
+ * Description:         Prints the fields of debug_fields, each at its own period.
+ *                      The values are read at the tick, the lines are sent over the next calls.
  *                      This function should be called in every loop of the main.
  */
 void debug_process(void){
-    static uint8_t line = 255;
-    uint8_t available_size;
-    //rtcc_timestamp_t rtcc_timestamp;
+    static uint32_t pending = 0;                    // Fields that are due, bit n is debug_fields[n]
+    static uint16_t budget = 0;                     // Bytes that may still be sent in this timer period
+    static uint8_t timers = 0;                      // Timer periods since the last tick
+#ifdef UART_DEBUG_DELTA_MESSAGES
+    static uint16_t keyframe = 0;                   // Ticks till the next keyframe
+#endif
+    debug_lane_t *lane = &debug_lanes[UART_DEBUG_LANE_TELEMETRY];
+    const uint32_t *args;
+    debug_index_t reserved, line, sent = 0;
+    debug_cycles_t start = UART_DEBUG_CYCLES();
+    uint8_t field;
+    
+    // Tell the host that data is missing, as soon as there is room again
+    if (debug_atomic_load(&debug_drops.report) != 0 &&
+        debug_free(&debug_lanes[UART_DEBUG_LANE_EVENT]) >= DEBUG_DROP_MARKER_LENGTH) {
+        debug_printf("[%lu bytes dropped]\r\n", debug_atomic_take(&debug_drops.report));
+    }
+#ifdef UART_DEBUG_COMMANDS
+    debug_command_poll();
+#endif
     
 #ifdef UART_DEBUG_TIMED_MESSAGES
+    if (debug_mode == UART_DEBUG_MODE_BINARY) {
+        // One binary record replaces all debug lines
+        if (get_software_timer_is_expired(debug_record_timer) == SOFTWARE_TIMER_TRUE) {
+            debug_send_record();
+        }
+        return;
+    }
     if (get_software_timer_is_expired(debug_timer) == SOFTWARE_TIMER_TRUE) {
-        // Start writing debug data
-        line = 0;
+        // The budget is per timer period, also when a tick is several periods
+        budget = UART_DEBUG_TICK_BUDGET;
+        timers++;
+    }
+    if (timers >= debug_tick_timers) {
+        // New tick, mark the fields that are due. Fields that did not fit in the
+        // budget of the last tick stay pending and are sent once.
+        timers = 0;
+#ifdef UART_DEBUG_DELTA_MESSAGES
+        if (keyframe == 0) {
+            // Every field sends its next line, changed or not
+            keyframe = UART_DEBUG_KEYFRAME_MS / UART_DEBUG_TICK_MS / debug_tick_timers;
+            if (keyframe == 0) {
+                keyframe = 1;
+            }
+            debug_field_keyframe = 0xFFFFFFFFUL;
+        }
+        keyframe--;
+#endif
+        for (field = 0; field < DEBUG_FIELD_COUNT; field++) {
+            if (debug_field_period[field] == 0 || (debug_field_off & (1UL << field)) != 0) {
+                continue;           // Disabled
+            }
+            if (debug_field_countdown[field] == 0) {
+                debug_field_countdown[field] = debug_field_period[field];
+                pending |= 1UL << field;
+            }
+            debug_field_countdown[field]--;
+        }
+        // Lines still pending from the last tick get new values too
+        pending = debug_snapshot_take(pending);
     }
 #endif
     
-    // Get empty size in buffer
-    if (debug_buffer.in > debug_buffer.out) {
-        available_size = debug_buffer.in - debug_buffer.out;
-    } else {
-        available_size = (debug_buffer.in + UART_DEBUG_BUFFER_SIZE) - debug_buffer.out;
-    }
-    // Only write new debug lines if half of the buffer is empty
-    // This way there is always room for instant debug messages
-    if (available_size > (UART_DEBUG_BUFFER_SIZE / 2)) {
-        switch (line) {
-            case 0:
-                if (get_ecu_state() == OFF) debug_string("OFF");
-                if (get_ecu_state() == IDLE) debug_string("IDLE");
-                if (get_ecu_state() == PUMPING) debug_string("PUMP");
-                if (get_ecu_state() == GLOWING) debug_string("GLOW");
-                if (get_ecu_state() == CRANKING) debug_string("START");
-                if (get_ecu_state() == START_DELAY) debug_string("START_DELAY");
-                if (get_ecu_state() == SAFETY_ON_DELAY) debug_string("PRERUNNING");
-                if (get_ecu_state() == RUNNING) debug_string("RUNNING");
-                if (get_ecu_state() == STOPPING) debug_string("STOPPING");
-                if (get_ecu_state() == ALARM) debug_string("ALARM");
-                debug_string(" ");
-                if (get_ecu_mode() == LOCAL_ONLY) debug_string("LOCAL_ONLY");
-                if (get_ecu_mode() == MANUAL) debug_string("MANUAL");
-                if (get_ecu_mode() == AUTOMATIC) debug_string("AUTOMATIC");
-                debug_string("\r\n");
-                break;
-            
-            case 1:
-                debug_string("Button: ");
-                debug_uint(get_user_interface_button_state(BUTTON_LOCAL_ROM_START_STOP, BUTTON_DOWN));
-                debug_uint(get_user_interface_button_state(BUTTON_LOCAL_ROM_MODE, BUTTON_DOWN));
-                debug_uint(get_user_interface_button_state(SWITCH_LOCAL_ROM_LOCAL, BUTTON_DOWN));
-                debug_uint(get_user_interface_button_state(SWITCH_LOCAL_ROM_REMOTE, BUTTON_DOWN));
-                debug_uint(get_user_interface_button_state(BUTTON_REMOTE_ROM_START_STOP, BUTTON_DOWN));
-                debug_string("\r\n");
-                break;
-                
-            case 2:
-                debug_string("Dig sensor closed: ");
-                debug_uint(get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_1));
-                debug_uint(get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_2));
-                debug_uint(get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_3));
-                debug_uint(get_sensor_digital_is_closed(SENSOR_DIGITAL_SWITCH_4));
-                debug_string(" activated: ");
-                debug_uint(get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_1));
-                debug_uint(get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_2));
-                debug_uint(get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_3));
-                debug_uint(get_sensor_digital_is_activated(SENSOR_DIGITAL_SWITCH_4));
-                debug_string(" - alt: ");
-                debug_uint(get_sensor_alt_feedback_is_activated());
-                
-                debug_string("\r\n");
-                break;
-            
-            case 3:
-                debug_string("E stop closed: ");
-                debug_uint(get_sensor_e_stop_is_closed());
-                debug_string(" activated: ");
-                debug_uint(get_sensor_e_stop_is_activated());
-                debug_string("\r\n");
-                break;
-                
-            case 4:
-                debug_string("Analog sensor res: ");
-                //debug_uint(get_sensor_analog_value(SENSOR_ANALOG_INPUT_1));
-                debug_uint(get_sensor_pic_engine_analog_sensor_raw(SENSOR_PIC_COM_AN_SENSOR_1));
-                debug_string(" ");
-                //debug_uint(get_sensor_analog_value(SENSOR_ANALOG_INPUT_2));
-                debug_uint(get_sensor_pic_engine_analog_sensor_raw(SENSOR_PIC_COM_AN_SENSOR_2));
-                debug_string(" ");
-                debug_uint(get_userio_analog_input_value());
-                debug_string(" ");
-                debug_uint(get_adc1_raw_value(ADC1_RESULT_USER_SENSOR));
-                debug_string("\r\n");
-                break;
-                
-            case 5:
-                debug_string("PT100: ");
-                
-                debug_uint(get_sensor_pic_pt100_temperature_raw(1));
-                debug_string(" ");
-                debug_uint(get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_1));
-                debug_string(" ");
-                debug_uint(get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_2));
-                debug_string(" ");
-                debug_uint(get_generator_measure_temperature_100mdeg(GENERATOR_MEASURE_TEMPERATURE_3));
-                debug_string("\r\n");
-                break;
-                
-            case 6:
-                debug_string("Battery: ");
-                debug_uint(get_sensor_battery_voltage_mv());
-                debug_string(" ");
-                debug_uint(get_adc1_raw_value(ADC1_RESULT_BATT_SENSE));
-                debug_string("\r\n");
-                break;
-                
-            case 7:
-                debug_string("Generator V: ");
-                debug_uint(get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_1));
-                debug_string(" ");
-                debug_uint(get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_2));
-                debug_string(" ");
-                debug_uint(get_generator_measure_voltage_100mv(GENERATOR_MEASURE_PHASE_3));
-                debug_string("\r\n");
-                break;
-                
-            case 8:
-                debug_string("Generator A: ");
-                debug_uint(get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_1));
-                debug_string(" ");
-                debug_uint(get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_2));
-                debug_string(" ");
-                debug_uint(get_generator_measure_current_100ma(GENERATOR_MEASURE_PHASE_3));
-                debug_string("\r\n");
-                break;
-                
-            case 9:
-                debug_string("Generator VA: ");
-                debug_uint(get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_1));
-                debug_string(" ");
-                debug_uint(get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_2));
-                debug_string(" ");
-                debug_uint(get_generator_measure_phase_power_va(GENERATOR_MEASURE_PHASE_3));
-                debug_string("\r\n");
-                break;
-                
-            case 10:
-                debug_string("Generator: ");
-                debug_uint(get_generator_measure_voltage_freq_10mhz());
-                debug_string(" Hz ");
-                debug_uint(get_generator_measure_rpm());
-                debug_string(" RPM ");
-                debug_uint(get_generator_measure_total_power_va());
-                debug_string(" VA\r\n");
-                break;
-                
-            case 11:
-                debug_string("Sensor alarm: ");
-                debug_uint(get_alarms_state(ALARM_SENSOR_DIGITAL_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_SENSOR_DIGITAL_2));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_SENSOR_DIGITAL_3));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_SENSOR_DIGITAL_4));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_SENSOR_ANALOG_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_SENSOR_ANALOG_2));
-                debug_string("\r\n");
-                break;
-                
-            case 12:
-                debug_string("Generator alarm: ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_LOW_VOLTAGE_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_LOW_VOLTAGE_2));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_HIGH_VOLTAGE_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_HIGH_VOLTAGE_2));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_HIGH_CURRENT_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_HIGH_CURRENT_2));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_HIGH_POWER_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERATOR_HIGH_POWER_2));
-                debug_string("\r\n");
-                break;
-                
-            case 13:
-                debug_string("Engine alarm: ");
-                debug_uint(get_alarms_state(ALARM_BATTERY_LOW_VOLTAGE));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_BATTERY_FAILED_TO_CHARGE));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_ENGINE_LOW_RPM_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_ENGINE_LOW_RPM_2));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_ENGINE_HIGH_RPM_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_ENGINE_HIGH_RPM_1));
-                debug_string("\r\n");
-                break;
-                
-            case 14:
-                debug_string("ECU alarm: ");
-                debug_uint(get_alarms_state(ALARM_GENERIC_FAILED_TO_START));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERIC_FAILED_TO_STOP));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERIC_E_STOP));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERIC_MAINTENANCE));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERIC_USER_DIG_1));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERIC_USER_DIG_2));
-                debug_string(" ");
-                debug_uint(get_alarms_state(ALARM_GENERIC_USER_AN));
-                debug_string("\r\n");
-                break;
-                
-            case 15:
-                debug_string("PIC com state: ");
-                debug_uint(get_sensor_pic_com_state());
-                debug_string("\r\n");
-                break;
-                
-                /*
-            case 16:
-                rtcc_timestamp = get_rtcc_timestamp();
-                debug_uint(rtcc_timestamp.hour);
-                debug_string(":");
-                debug_uint(rtcc_timestamp.min);
-                debug_string(":");
-                debug_uint(rtcc_timestamp.sec);
-                debug_string(" ");
-                debug_uint(rtcc_timestamp.day);
-                debug_string("-");
-                debug_uint(rtcc_timestamp.month);
-                debug_string("-20");
-                debug_uint(rtcc_timestamp.year);
-                debug_string("\r\n");
-                break;
-                
-            case 17:
-                if (get_rtcc_backup_battery_good()) {
-                    debug_string("RTCC backup battery ok\r\n");
-                } else {
-                    debug_string("RTCC backup battery fail\r\n");
-                }
-                break;*/
-                
-                
-            default:
-                if (line != 255) {
-                    debug_string("\r\n");
-                    line = 255;
-                }
-                break;
+    // Lines in the order of the table, till the work of this call is done.
+    // Only write new debug lines if half of the telemetry buffer is empty,
+    // so the queued lines are never older than half a buffer
+    reserved = DEBUG_STATE_INDEX(debug_atomic_load(&lane->reserve));
+    while (pending != 0 && budget != 0 && debug_free(lane) > lane->size / 2) {
+        for (field = 0; (pending & (1UL << field)) == 0; field++) {
         }
-        if (line<255) {
-            line++;
+        pending &= ~(1UL << field);
+        args = &debug_snapshot.values[debug_snapshot.offset[field]];
+        if (debug_fields[field].trace == DEBUG_FIELD_ECU_STATE) {
+            debug_send_ecu_state(args);
+        } else {
+#ifdef UART_DEBUG_DELTA_MESSAGES
+            if (!debug_field_changed(field, args, debug_snapshot.count[field])) {
+                continue;           // Nothing new, try the next field
+            }
+#endif
+            debug_trace_lane(UART_DEBUG_LANE_TELEMETRY, DEBUG_LINE_PREFIX, debug_fields[field].trace, args,
+                             debug_snapshot.count[field]);
+        }
+        // The last line of a tick may overrun the budget, the next tick starts a new one
+        line = DEBUG_STATE_INDEX(debug_atomic_load(&lane->reserve)) - reserved;
+        reserved += line;
+        budget = (line < budget) ? budget - line : 0;
+        sent += line;
+        if (sent >= UART_DEBUG_CALL_BYTES || (debug_cycles_t)(UART_DEBUG_CYCLES() - start) >= UART_DEBUG_CALL_CYCLES) {
+            break;
         }
     }
 }
 
 int8_t uart_debug_ready(void) {
-    if (debug_buffer.in == debug_buffer.out) {
-        return 1;
-    } else {
+    uint8_t n;
+    
+    for (n = 0; n < UART_DEBUG_LANES; n++) {
+        if (DEBUG_STATE_INDEX(debug_atomic_load(&debug_lanes[n].reserve)) != debug_atomic_load(&debug_lanes[n].out)) {
+            return 0;
+        }
+    }
+#ifdef UART_DEBUG_COMPRESS
+    if (debug_compress.code_sent != debug_compress.code_length) {
         return 0;
     }
+#endif
+    return 1;
 }
@@ -2,21 +2,139 @@
 #define	UATR_DEBUG_H
 
 #include <stdint.h>
+#include "uart_debug_trace.h"
 
 
 #define UART_DEBUG_PCLK         50000000    // Peripheral clock
 #define UART_DEBUG_DATA_RATE    115200
-#define UART_DEBUG_BUFFER_SIZE  200
+#define UART_DEBUG_BUFFER_SIZE  256         // Must be a power of two, max 32768 with 16 bit indices
+
+// Output lanes, each with its own buffer. The uart interrupt sends the lane with the
+// lowest number first, and only switches lanes between messages.
+#define UART_DEBUG_LANE_ALARM           0       // Alarms, see debug_printf_lane
+#define UART_DEBUG_LANE_EVENT           1       // Instant messages, debug_string and friends
+#define UART_DEBUG_LANE_TELEMETRY       2       // Timed messages of debug_process
+#define UART_DEBUG_LANES                3
+#define UART_DEBUG_ALARM_BUFFER_SIZE    64      // Must be a power of two, the event lane uses UART_DEBUG_BUFFER_SIZE
+#define UART_DEBUG_TELEMETRY_BUFFER_SIZE    256 // Must be a power of two
 
 #define DEBUG_NUMBER_LINES      4
 #define DEBUG_TEXT_LENGTH       32
 #define DEBUG_VALUE_LENGTH      10
 #define DEBUG_LINE_LENGTH       (DEBUG_TEXT_LENGTH + DEBUG_VALUE_LENGTH + 2)  //add 2 for the \n\r characters
+#define DEBUG_PRINTF_LENGTH     80          // Max length of a debug_printf line, including the null character
 
-// Uncomment to enable waiting for all debug data to be send
+// Uncomment to wait for room in the debug buffer by default (UART_DEBUG_BLOCK)
 //#define UART_DEBUG_WAIT_TILL_SEND
 // Uncomment to enable timed debug messages
 #define UART_DEBUG_TIMED_MESSAGES
+// Uncomment to only send timed debug lines that changed, see UART_DEBUG_KEYFRAME_MS
+//#define UART_DEBUG_DELTA_MESSAGES
+// Uncomment to start the timed debug lines with the RTC time of their snapshot, "YYYY-MM-DD hh:mm:ss ".
+// The time adds 20 characters in front of the DEBUG_PRINTF_LENGTH of the line, see utl_datetime.
+//#define UART_DEBUG_TIMESTAMPS
+// Uncomment to measure the debug output, see debug_get_stats
+//#define UART_DEBUG_STATS
+// Uncomment to use 32 bit buffer indices, only for targets that read and write 32 bit atomically
+//#define UART_DEBUG_INDEX_32BIT
+// Uncomment to accept commands on the uart rx pin, see debug_command
+//#define UART_DEBUG_COMMANDS
+#define UART_DEBUG_RX_BUFFER_SIZE       32      // Must be a power of two, max 128
+#define UART_DEBUG_COMMAND_LENGTH       32      // Max length of a command line
+#define UART_DEBUG_COMMAND_BUFFER       64      // Received lines waiting for a reply to end, at least UART_DEBUG_COMMAND_LENGTH + 1, max 255
+// Uncomment to compress the uart stream, see uart_debug_compress.h and tools/debug_expand.c
+//#define UART_DEBUG_COMPRESS
+#ifdef UART_DEBUG_COMPRESS
+#define UART_DEBUG_LINK_RATIO           2       // Characters per byte on the wire, plans the tick budget (see the ratio in uart_debug_compress.h)
+#else
+#define UART_DEBUG_LINK_RATIO           1
+#endif
+
+// Output modes of the timed debug messages
+#define UART_DEBUG_MODE_ASCII           0       // Text lines every second
+#define UART_DEBUG_MODE_BINARY          1       // COBS framed binary records, see uart_debug_record.h
+#define UART_DEBUG_MODE_TRACE           2       // Text lines as deferred traces, see uart_debug_trace.h
+#define UART_DEBUG_DEFAULT_MODE         UART_DEBUG_MODE_ASCII
+#define UART_DEBUG_RECORD_PERIOD_MS     200     // Period of the binary records
+
+// What a print does when its message does not fit in the debug buffer, see debug_set_policy
+#define UART_DEBUG_DROP_NEWEST          0       // Send what fits, drop the end of the message
+#define UART_DEBUG_DROP_OLDEST          1       // Drop the oldest lines that are not sent yet, the line on the wire may be cut
+#define UART_DEBUG_BLOCK                2       // Wait for room, drop the message after UART_DEBUG_BLOCK_LOOPS
+#define UART_DEBUG_DROP_MESSAGE         3       // Drop the whole message, it is never torn
+#ifdef UART_DEBUG_WAIT_TILL_SEND
+#define UART_DEBUG_DEFAULT_POLICY       UART_DEBUG_BLOCK
+#else
+#define UART_DEBUG_DEFAULT_POLICY       UART_DEBUG_DROP_NEWEST
+#endif
+#define UART_DEBUG_BLOCK_LOOPS          50000   // About 10 ms at 50 MIPS
+
+// Timed debug messages are scheduled in ticks, every line has its own period (debug_fields in uart_debug.c).
+// This is the period of the tick timer, the "tick" command makes a tick a multiple of it.
+#define UART_DEBUG_TICK_MS              100
+// Bytes the timed messages may send per tick, 3/4 of the uart rate leaves room for instant messages
+#define UART_DEBUG_TICK_BUDGET          ((UART_DEBUG_DATA_RATE / 10) * UART_DEBUG_TICK_MS / 1000 * UART_DEBUG_LINK_RATIO * 3 / 4)
+// Work of one debug_process call: lines are sent till this many bytes are written or this many
+// UART_DEBUG_CYCLES counts passed, at least one line per call. 1 byte sends one line per call.
+#define UART_DEBUG_CALL_BYTES           1
+#define UART_DEBUG_CALL_CYCLES          0xFFFF
+// With UART_DEBUG_DELTA_MESSAGES every line is sent at least once per keyframe, so a host that
+// attaches late has all values after this time
+#define UART_DEBUG_KEYFRAME_MS          10000
+
+
+#ifdef UART_DEBUG_INDEX_32BIT
+typedef uint32_t debug_index_t;
+#else
+typedef uint16_t debug_index_t;
+#endif
+
+// Cycle counter for the stats, e.g. a free running timer: #define UART_DEBUG_CYCLES() TMR1
+// Differences are taken in 16 bits, so one measured call must take less than 65536 counts
+#ifndef UART_DEBUG_CYCLES
+#define UART_DEBUG_CYCLES()     0
+#endif
+typedef uint16_t debug_cycles_t;
+
+
+// Reserved part of the debug buffer, the second part is used when the buffer wraps
+typedef struct {
+    char *ptr[2];           // Start of each part
+    debug_index_t len[2];   // Length of each part, len[1] is 0 when the span does not wrap
+    debug_cycles_t start;   // Cycle count at the reserve, for the stats
+    uint8_t lane;           // Lane of the reserved parts
+} debug_span_t;
+
+// Measurements of the debug output, only counted with UART_DEBUG_STATS
+typedef struct {
+    debug_index_t max_used[UART_DEBUG_LANES];   // High water mark of each lane in bytes
+    uint32_t bytes_queued;      // Bytes committed by the producers
+    uint32_t bytes_sent;        // Bytes written to the uart, characters before coding with UART_DEBUG_COMPRESS
+    uint32_t isr_count;         // Uart interrupts
+    uint32_t isr_cycles;        // Cycles spent in the uart interrupt
+    uint32_t producer_count;    // Committed reserves
+    uint32_t producer_cycles;   // Cycles from reserve to commit, including zero-copy conversions
+    uint32_t dropped_bytes;
+    uint32_t dropped_messages;
+    uint32_t alarm_count;       // Alarm lane sends, the waits are in characters sent before them:
+    uint32_t alarm_wait;        // the time is wait * 10 / UART_DEBUG_DATA_RATE s, plus the uart fifo (uncompressed)
+    uint32_t alarm_wait_max;
+} debug_stats_t;
+
+// Output that is sent a piece at a time from the main loop, see debug_stream_start
+typedef struct debug_stream debug_stream_t;
+// Formats line stream->index into str and returns its length, 0 ends the stream
+typedef uint8_t (*debug_stream_line_t)(const debug_stream_t *stream, char *str, uint8_t size);
+struct debug_stream {
+    uint8_t lane;                       // Lane the text is sent in
+    debug_stream_line_t line;           // 0 when the stream is done
+    const void *context;                // For the line function
+    uint16_t count;                     // For the line function, e.g. the number of lines
+    uint16_t index;                     // Line that is formatted next
+    uint8_t length;                     // Length of the formatted line
+    uint8_t position;                   // Next character of the line to send
+    char text[DEBUG_PRINTF_LENGTH];     // The formatted line
+};
 
 
 /**
@@ -87,6 +205,279 @@ void debug_int(int32_t value);
  */
 void debug_hex(uint32_t value);
 
+/**
+ *     <b>Function prototype:</b><br>   void debug_printf(const char *fmt, ...)
+ * <br>
+ * <br><b>Description:</b><br>          Formats a line and prints it to the uart port in one call.
+ * <br>                                 Supports %d %u %x %X %c %s, width, '0' and '-' flags and
+ * <br>                                 'l' for 32 bit arguments (see utl_vsnprintf).
+ * <br>                                 The line is truncated to DEBUG_PRINTF_LENGTH-1 characters.
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized
+ * <br>
+ * <br><b>Inputs:</b><br>               const char *fmt:  Format string
+ * <br>                                 ...:              Values to print
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_printf("Battery: %lu mV\r\n", battery_mv);  // Print to debug uart
+ */
+void debug_printf(const char *fmt, ...);
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_printf_lane(uint8_t lane, const char *fmt, ...)
+ * <br>
+ * <br><b>Description:</b><br>          Same as debug_printf, in another lane than the event lane.
+ * <br>                                 A line in the alarm lane is sent as soon as the message on
+ * <br>                                 the wire is done, whatever is queued in the other lanes.
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized
+ * <br>
+ * <br><b>Inputs:</b><br>               uint8_t lane:     UART_DEBUG_LANE_ALARM, _EVENT or _TELEMETRY
+ * <br>                                 const char *fmt:  Format string
+ * <br>                                 ...:              Values to print
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_printf_lane(UART_DEBUG_LANE_ALARM, "E stop\r\n");
+ */
+void debug_printf_lane(uint8_t lane, const char *fmt, ...);
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_stream_start(debug_stream_t *stream, uint8_t lane, debug_stream_line_t line, const void *context, uint16_t count)
+ * <br>
+ * <br><b>Description:</b><br>          Starts output that is longer than the debug buffer, like a
+ * <br>                                 table or a memory dump. The line function formats one line
+ * <br>                                 at a time, debug_stream_process sends it as room frees up
+ * <br>                                 and goes on from the exact character where it stopped.
+ * <br>                                 Nothing is dropped and nothing waits for the uart.
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized
+ * <br>
+ * <br><b>Inputs:</b><br>               debug_stream_t *stream:     Context, must stay valid till done
+ * <br>                                 uint8_t lane:               Lane of the text, e.g. UART_DEBUG_LANE_TELEMETRY
+ * <br>                                 debug_stream_line_t line:   Formats the lines
+ * <br>                                 const void *context:        Data of the line function
+ * <br>                                 uint16_t count:             Count of the line function
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_stream_start(&stream, UART_DEBUG_LANE_TELEMETRY, alarm_line, alarm_table, ALARM_COUNT);
+ */
+void debug_stream_start(debug_stream_t *stream, uint8_t lane, debug_stream_line_t line, const void *context, uint16_t count);
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_stream_dump(debug_stream_t *stream, uint8_t lane, const void *data, uint16_t size)
+ * <br>
+ * <br><b>Description:</b><br>          Starts a hex dump of size bytes as a stream, 16 bytes per
+ * <br>                                 line after the offset: "0010: 01 02 ...".
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized, data must stay valid till done
+ * <br>
+ * <br><b>Inputs:</b><br>               debug_stream_t *stream:     Context, must stay valid till done
+ * <br>                                 uint8_t lane:               Lane of the text
+ * <br>                                 const void *data:           Bytes to dump
+ * <br>                                 uint16_t size:              Number of bytes
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_stream_dump(&stream, UART_DEBUG_LANE_TELEMETRY, &record, sizeof(record));
+ */
+void debug_stream_dump(debug_stream_t *stream, uint8_t lane, const void *data, uint16_t size);
+
+/**
+ *     <b>Function prototype:</b><br>   uint8_t debug_stream_process(debug_stream_t *stream)
+ * <br>
+ * <br><b>Description:</b><br>          Sends as much of a stream as fits in the free upper half of
+ * <br>                                 the buffer of its lane, like the timed lines of debug_process,
+ * <br>                                 so there is always room left for other messages in the lane.
+ * <br>                                 Call it in every loop of the main till it returns 0.
+ * <br>
+ * <br><b>Precondition:</b><br>         The stream must be started with debug_stream_start
+ * <br>
+ * <br><b>Inputs:</b><br>               debug_stream_t *stream:     The stream
+ * <br>
+ * <br><b>Outputs:</b><br>              uint8_t:                    1 while text is left to send, else 0
+ * <br>
+ * <br><b>Example:</b><br>              debug_stream_process(&stream);
+ */
+uint8_t debug_stream_process(debug_stream_t *stream);
+
+/**
+ *     <b>Function prototype:</b><br>   debug_index_t debug_reserve(debug_index_t size, debug_span_t *span)
+ * <br>
+ * <br><b>Description:</b><br>          Reserves room in the debug buffer so text can be written
+ * <br>                                 straight into it, without a temporary string.
+ * <br>                                 The room is handed out as one contiguous part, or two
+ * <br>                                 when the buffer wraps. Less than size bytes are reserved
+ * <br>                                 when the buffer is almost full.
+ * <br>                                 Every reserve must be followed by a debug_commit.
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized
+ * <br>
+ * <br><b>Inputs:</b><br>               debug_index_t size: Number of bytes to reserve
+ * <br>                                 debug_span_t *span: Receives the reserved parts
+ * <br>
+ * <br><b>Outputs:</b><br>              debug_index_t:      Number of bytes reserved
+ * <br>
+ * <br><b>Example:</b><br>              if (debug_reserve(2, &span) == 2) {...}
+ */
+debug_index_t debug_reserve(debug_index_t size, debug_span_t *span);
+
+/**
+ * Function prototype:  debug_index_t debug_reserve_lane(uint8_t lane, debug_index_t size, debug_span_t *span)
+ * Description:         Same as debug_reserve, in a lane, debug_reserve uses UART_DEBUG_LANE_EVENT
+ */
+debug_index_t debug_reserve_lane(uint8_t lane, debug_index_t size, debug_span_t *span);
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_commit(const debug_span_t *span)
+ * <br>
+ * <br><b>Description:</b><br>          Hands a reserved and filled span to the uart port
+ * <br>
+ * <br><b>Precondition:</b><br>         span must be reserved with debug_reserve
+ * <br>
+ * <br><b>Inputs:</b><br>               const debug_span_t *span: The reserved parts
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_commit(&span);
+ */
+void debug_commit(const debug_span_t *span);
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_trace(uint8_t id, const uint32_t *args, uint8_t count)
+ * <br>
+ * <br><b>Description:</b><br>          Logs a message from the trace dictionary (uart_debug_trace.h).
+ * <br>                                 In UART_DEBUG_MODE_TRACE only the id and the raw arguments
+ * <br>                                 are sent and the host tool formats the text, in the other
+ * <br>                                 modes the message is formatted here with debug_printf.
+ * <br>                                 Use the DEBUG_TRACE macro to pass the arguments.
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized
+ * <br>
+ * <br><b>Inputs:</b><br>               uint8_t id:             Message id, a debug_trace_id_t
+ * <br>                                 const uint32_t *args:   Arguments of the message
+ * <br>                                 uint8_t count:          Number of arguments, max DEBUG_TRACE_MAX_ARGS
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              DEBUG_TRACE(TRACE_BATTERY, battery_mv, battery_raw);
+ */
+void debug_trace(uint8_t id, const uint32_t *args, uint8_t count);
+
+// Logs a trace message with one or more arguments, every argument is converted to uint32_t
+#define DEBUG_TRACE(id, ...)    do { \
+        const uint32_t debug_trace_args[] = { __VA_ARGS__ }; \
+        debug_trace((id), debug_trace_args, sizeof(debug_trace_args) / sizeof(debug_trace_args[0])); \
+    } while (0)
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_set_mode(uint8_t mode)
+ * <br>
+ * <br><b>Description:</b><br>          Selects the output of debug_process: ASCII lines, one
+ * <br>                                 binary record every UART_DEBUG_RECORD_PERIOD_MS, or
+ * <br>                                 the ASCII lines as deferred traces.
+ * <br>                                 Messages printed with debug_string and friends are
+ * <br>                                 always sent as text.
+ * <br>
+ * <br><b>Precondition:</b><br>         None
+ * <br>
+ * <br><b>Inputs:</b><br>               uint8_t mode:  UART_DEBUG_MODE_ASCII, _BINARY or _TRACE
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_set_mode(UART_DEBUG_MODE_BINARY);
+ */
+void debug_set_mode(uint8_t mode);
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_set_policy(uint8_t policy)
+ * <br>
+ * <br><b>Description:</b><br>          Selects what a print does when the debug buffer is full.
+ * <br>                                 Lost data is counted and reported in the stream with a
+ * <br>                                 "[N bytes dropped]" line from debug_process.
+ * <br>                                 UART_DEBUG_BLOCK must only be used by code that runs below
+ * <br>                                 the priority of the uart interrupt, else it waits in vain
+ * <br>                                 till the timeout.
+ * <br>
+ * <br><b>Precondition:</b><br>         None
+ * <br>
+ * <br><b>Inputs:</b><br>               uint8_t policy:  UART_DEBUG_DROP_NEWEST, _DROP_OLDEST, _BLOCK or _DROP_MESSAGE
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_set_policy(UART_DEBUG_DROP_MESSAGE);
+ */
+void debug_set_policy(uint8_t policy);
+
+/**
+ * Function prototype:  uint32_t debug_dropped_bytes(void)
+ * Description:         Returns the number of bytes that were dropped since the start
+ */
+uint32_t debug_dropped_bytes(void);
+
+/**
+ * Function prototype:  uint32_t debug_dropped_messages(void)
+ * Description:         Returns the number of messages that were dropped or cut off since the start
+ */
+uint32_t debug_dropped_messages(void);
+
+/**
+ *     <b>Function prototype:</b><br>   void debug_get_stats(debug_stats_t *stats)
+ * <br>
+ * <br><b>Description:</b><br>          Reads the measurements of the debug output since the start.
+ * <br>                                 The counters are only kept with UART_DEBUG_STATS, the cycles
+ * <br>                                 only when UART_DEBUG_CYCLES is defined. With UART_DEBUG_STATS
+ * <br>                                 debug_process also prints them every 10 s.
+ * <br>                                 Average cycles per call are isr_cycles / isr_count and
+ * <br>                                 producer_cycles / producer_count.
+ * <br>                                 max_used holds the high water mark of each lane. The alarm
+ * <br>                                 wait counts the characters that were sent from the moment the
+ * <br>                                 uart interrupt saw an alarm till its first character.
+ * <br>
+ * <br><b>Precondition:</b><br>         None
+ * <br>
+ * <br><b>Inputs:</b><br>               debug_stats_t *stats:  Receives the measurements
+ * <br>
+ * <br><b>Outputs:</b><br>              None
+ * <br>
+ * <br><b>Example:</b><br>              debug_get_stats(&stats);
+ */
+void debug_get_stats(debug_stats_t *stats);
+
+#ifdef UART_DEBUG_COMMANDS
+/**
+ *     <b>Function prototype:</b><br>   uint8_t debug_command(const char *line, uint8_t length)
+ * <br>
+ * <br><b>Description:</b><br>          Runs a command that changes the timed debug messages and
+ * <br>                                 prints the reply, "OK" or "ERR" for the settings.
+ * <br>                                 debug_process runs the lines that are received on the
+ * <br>                                 uart, ended by '\r' or '\n'.
+ * <br>                                 A line is a debug_fields entry, given by its number, its
+ * <br>                                 trace name without TRACE_ (e.g. battery) or "all".
+ * <br>                                 lines                 Lists number, name, period and state
+ * <br>                                 on line / off line    Starts or stops a line
+ * <br>                                 rate line ms          Sets the period of a line
+ * <br>                                 tick ms               Sets the tick, a multiple of
+ * <br>                                                       UART_DEBUG_TICK_MS, periods scale with it
+ * <br>                                 mode ascii|binary|trace   See debug_set_mode
+ * <br>                                 stats                 Prints the debug_get_stats counters
+ * <br>                                 Periods are rounded down to whole ticks, 1 to 255 ticks.
+ * <br>
+ * <br><b>Precondition:</b><br>         Uart debugging must be initialized, only call it from the
+ * <br>                                 main loop, like debug_process
+ * <br>
+ * <br><b>Inputs:</b><br>               const char *line:  The command, no null character is needed
+ * <br>                                 uint8_t length:    Number of characters
+ * <br>
+ * <br><b>Outputs:</b><br>              uint8_t:           1 when the command was run, else 0
+ * <br>
+ * <br><b>Example:</b><br>              debug_command("off all", 7);
+ */
+uint8_t debug_command(const char *line, uint8_t length);
+#endif
+
 /**
  *     <b>Function prototype:</b><br>   void debug_uart_init(void)
  * <br>
@@ -105,7 +496,17 @@ void debug_uart_init(void);
 /**
  *     <b>Function prototype:</b><br>   void debug_process(void)
  * <br>
- * <br><b>Description:</b><br>          Prints predefined debug data to the uart every second.
+ * <br><b>Description:</b><br>          Prints predefined debug data to the uart, every line at its
+ * <br>                                 own period: alarms at 10 Hz, generator values at 2 Hz,
+ * <br>                                 the battery every 10 s and the rest every second.
+ * <br>                                 All values of a tick are read in one snapshot, the lines
+ * <br>                                 are then sent over the next calls, UART_DEBUG_CALL_BYTES
+ * <br>                                 or UART_DEBUG_CALL_CYCLES per call.
+ * <br>                                 At most UART_DEBUG_TICK_BUDGET bytes are sent per tick.
+ * <br>                                 With UART_DEBUG_DELTA_MESSAGES a line is only sent when a
+ * <br>                                 value changed more than its deadband, or once per keyframe.
+ * <br>                                 With UART_DEBUG_COMMANDS it also runs the received
+ * <br>                                 commands, see debug_command.
  * <br>                                 This function should be called in every loop of the main.
  * <br>
  * <br><b>Precondition:</b><br>         Uart debugging must be initialized
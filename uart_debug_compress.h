@@ -0,0 +1,59 @@
+#ifndef UART_DEBUG_COMPRESS_H
+#define UART_DEBUG_COMPRESS_H
+
+/*
+ * Stream compression of the debug uart, enabled with UART_DEBUG_COMPRESS in uart_debug.h.
+ * Shared between the firmware and the host decompressor (tools/debug_expand.c).
+ *
+ * The uart interrupt codes the text of the lanes one token at a time, a token never
+ * crosses a message boundary. Codes on the wire:
+ *
+ *   0x00..0x7F     Literal character
+ *   0x80..0xBF     Dictionary entry 0..63
+ *   0xC0..0xDF     Copy of 3..34 characters from the window, followed by one byte with
+ *                  the distance back, 1..255. The copy never overlaps the new text.
+ *   0xE0..0xFE     Run of 3..33 characters of DEBUG_COMPRESS_DIGITS, followed by their
+ *                  positions in it packed two per byte, high nibble first, the last low
+ *                  nibble is 0 for an odd run
+ *   0xFF           Escape, the next byte is a literal character of 0x80 or above
+ *   0xFF 0x00 0xFF 0x00
+ *                  Sync, the window starts over as all zeros at position 0. An escape is
+ *                  never followed by a byte below 0x80 otherwise.
+ *
+ * Window:          The last 256 characters of text since the last sync. Both sides add
+ *                  every character they send or decode to it.
+ * Dictionary:      The literal parts of the formats in uart_debug_trace.h, in message
+ *                  order, the text in between the conversions. Parts shorter than 2
+ *                  characters and repeats are skipped, parts longer than
+ *                  DEBUG_COMPRESS_MATCH_MAX are cut to that length. A host decoder built
+ *                  from the same uart_debug_trace.h has the same dictionary.
+ *
+ * Sync:            The coder sends a sync before the first message after reset, and again
+ *                  before the first message after every DEBUG_COMPRESS_SYNC_CHARS characters.
+ *                  A decoder skips bytes till a sync, so a capture can start anywhere and a
+ *                  lost byte only garbles the text up to the next sync.
+ *
+ * Ratio:           Measured on the host bench (tools/debug_bench), characters per wire byte:
+ *                  3.8 for the default telemetry schedule, 2.6 with all timed lines at 100 ms
+ *                  (the same label comes back after more than the window) and 2.2 for lines
+ *                  of changing numbers. 3 or more only holds for the default schedule, so
+ *                  UART_DEBUG_LINK_RATIO plans with 2.
+ */
+
+#define DEBUG_COMPRESS_DICT             0x80
+#define DEBUG_COMPRESS_DICT_SIZE        64
+#define DEBUG_COMPRESS_COPY             0xC0
+#define DEBUG_COMPRESS_COPY_MIN         3
+#define DEBUG_COMPRESS_RUN              0xE0
+#define DEBUG_COMPRESS_RUN_MIN          3
+#define DEBUG_COMPRESS_RUN_MAX          33
+#define DEBUG_COMPRESS_ESCAPE           0xFF
+#define DEBUG_COMPRESS_SYNC_LENGTH      4       // Escape 0x00 escape 0x00
+#define DEBUG_COMPRESS_SYNC_CHARS       2048    // Characters between syncs, at least
+
+#define DEBUG_COMPRESS_MATCH_MAX        34      // Longest token in characters, also of a copy
+#define DEBUG_COMPRESS_CODE_MAX         (1 + (DEBUG_COMPRESS_RUN_MAX + 1) / 2)   // Longest token on the wire
+#define DEBUG_COMPRESS_WINDOW_SIZE      256
+#define DEBUG_COMPRESS_DIGITS           "0123456789 .-:\r\n"
+
+#endif
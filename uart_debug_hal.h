@@ -0,0 +1,42 @@
+#ifndef UART_DEBUG_HAL_H
+#define UART_DEBUG_HAL_H
+
+/*
+ * Uart access of the debug output (uart_debug.c).
+ * On the dsPIC the macros use the UART2 registers. On other targets they use the
+ * emulated uart of tools/host/uart_debug_host.c, so the debug output can be run
+ * and measured on a workstation.
+ */
+
+#if defined(__XC16__)
+#include <xc.h>
+
+#define DEBUG_UART_TX_FULL()        (U2STAbits.UTXBF)       // Transmit fifo is full
+#define DEBUG_UART_TX_WRITE(c)      (U2TXREG = (c))         // Puts a character in the transmit fifo
+#define DEBUG_UART_TX_IRQ_SET()     (_U2TXIF = 1)           // Requests the transmit interrupt
+#define DEBUG_UART_TX_IRQ_CLEAR()   (_U2TXIF = 0)
+#define DEBUG_UART_TX_ISR           __attribute__((interrupt(auto_psv))) _U2TXInterrupt
+#define DEBUG_UART_RX_AVAILABLE()   (U2STAbits.URXDA)       // Receive fifo holds a character
+#define DEBUG_UART_RX_READ()        ((char)U2RXREG)         // Takes a character from the receive fifo
+#define DEBUG_UART_RX_IRQ_CLEAR()   (_U2RXIF = 0)
+#define DEBUG_UART_RX_OVERRUN()     (U2STAbits.OERR)        // Reception stops till the overrun is cleared
+#define DEBUG_UART_RX_OVERRUN_CLEAR()   (U2STAbits.OERR = 0)
+#define DEBUG_UART_RX_ISR           __attribute__((interrupt(auto_psv))) _U2RXInterrupt
+#else
+#include "uart_debug_host.h"
+
+#define DEBUG_UART_TX_FULL()        debug_host_tx_full()
+#define DEBUG_UART_TX_WRITE(c)      debug_host_tx_write(c)
+#define DEBUG_UART_TX_IRQ_SET()     debug_host_tx_irq(1)
+#define DEBUG_UART_TX_IRQ_CLEAR()   debug_host_tx_irq(0)
+#define DEBUG_UART_TX_ISR           debug_host_tx_isr
+#define DEBUG_UART_RX_AVAILABLE()   debug_host_rx_available()
+#define DEBUG_UART_RX_READ()        debug_host_rx_read()
+#define DEBUG_UART_RX_IRQ_CLEAR()   debug_host_rx_irq(0)
+#define DEBUG_UART_RX_OVERRUN()     0
+#define DEBUG_UART_RX_OVERRUN_CLEAR()
+#define DEBUG_UART_RX_ISR           debug_host_rx_isr
+#endif
+
+
+#endif
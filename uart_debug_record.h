@@ -0,0 +1,103 @@
+#ifndef UART_DEBUG_RECORD_H
+#define UART_DEBUG_RECORD_H
+
+#include <stdint.h>
+
+/*
+ * Binary telemetry record, sent instead of the ASCII lines in UART_DEBUG_MODE_BINARY.
+ * Shared between the firmware and the host decoder (tools/debug_decode.c).
+ *
+ * Frame on the wire:   COBS( type | sequence | record | crc16 ) 0x00
+ *                      crc16 is CRC 16 CCITT (utl_calc_crc) over type, sequence and record
+ *                      All multi byte values are little endian
+ *
+ * Trace frame:         COBS( type | id | args | crc16 ) 0x00
+ *                      id indexes the dictionary in uart_debug_trace.h, every argument is
+ *                      an unsigned LEB128 number: 7 bits per byte, low bits first, bit 7 set
+ *                      on all bytes but the last. Values below 128 take one byte.
+ */
+
+#define DEBUG_FRAME_TYPE_RECORD     0x01    // One telemetry snapshot
+#define DEBUG_FRAME_TYPE_TRACE      0x02    // One deferred trace message
+#define DEBUG_FRAME_HEADER_SIZE     2       // type, sequence
+#define DEBUG_FRAME_CRC_SIZE        2
+
+// DEBUG_RECORD_FIELD(name, size in bytes, signed), in the order of the record
+// Signed fields are two's complement, the decoder sign extends them
+#define DEBUG_RECORD_FIELDS \
+    DEBUG_RECORD_FIELD(ecu_state,               1, 0) \
+    DEBUG_RECORD_FIELD(ecu_mode,                1, 0) \
+    DEBUG_RECORD_FIELD(buttons,                 1, 0) /* bit 0..4: local start/stop, local mode, local, remote, remote start/stop */ \
+    DEBUG_RECORD_FIELD(dig_closed,              1, 0) /* bit 0..3: digital switch 1..4 */ \
+    DEBUG_RECORD_FIELD(dig_activated,           1, 0) /* bit 0..3: digital switch 1..4 */ \
+    DEBUG_RECORD_FIELD(alt_activated,           1, 0) \
+    DEBUG_RECORD_FIELD(e_stop_closed,           1, 0) \
+    DEBUG_RECORD_FIELD(e_stop_activated,        1, 0) \
+    DEBUG_RECORD_FIELD(an_sensor_1_raw,         2, 0) \
+    DEBUG_RECORD_FIELD(an_sensor_2_raw,         2, 0) \
+    DEBUG_RECORD_FIELD(userio_analog,           2, 0) \
+    DEBUG_RECORD_FIELD(adc_user_raw,            2, 0) \
+    DEBUG_RECORD_FIELD(pt100_raw,               2, 0) \
+    DEBUG_RECORD_FIELD(temp_1_100mdeg,          2, 1) \
+    DEBUG_RECORD_FIELD(temp_2_100mdeg,          2, 1) \
+    DEBUG_RECORD_FIELD(temp_3_100mdeg,          2, 1) \
+    DEBUG_RECORD_FIELD(battery_mv,              2, 0) \
+    DEBUG_RECORD_FIELD(battery_raw,             2, 0) \
+    DEBUG_RECORD_FIELD(gen_v_1_100mv,           2, 0) \
+    DEBUG_RECORD_FIELD(gen_v_2_100mv,           2, 0) \
+    DEBUG_RECORD_FIELD(gen_v_3_100mv,           2, 0) \
+    DEBUG_RECORD_FIELD(gen_a_1_100ma,           2, 0) \
+    DEBUG_RECORD_FIELD(gen_a_2_100ma,           2, 0) \
+    DEBUG_RECORD_FIELD(gen_a_3_100ma,           2, 0) \
+    DEBUG_RECORD_FIELD(gen_va_1,                4, 0) \
+    DEBUG_RECORD_FIELD(gen_va_2,                4, 0) \
+    DEBUG_RECORD_FIELD(gen_va_3,                4, 0) \
+    DEBUG_RECORD_FIELD(gen_freq_10mhz,          2, 0) \
+    DEBUG_RECORD_FIELD(gen_rpm,                 2, 0) \
+    DEBUG_RECORD_FIELD(gen_total_va,            4, 0) \
+    DEBUG_RECORD_FIELD(alarm_sensor_dig_1,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_sensor_dig_2,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_sensor_dig_3,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_sensor_dig_4,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_sensor_an_1,       1, 0) \
+    DEBUG_RECORD_FIELD(alarm_sensor_an_2,       1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_low_v_1,       1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_low_v_2,       1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_high_v_1,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_high_v_2,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_high_a_1,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_high_a_2,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_high_p_1,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_gen_high_p_2,      1, 0) \
+    DEBUG_RECORD_FIELD(alarm_batt_low_v,        1, 0) \
+    DEBUG_RECORD_FIELD(alarm_batt_no_charge,    1, 0) \
+    DEBUG_RECORD_FIELD(alarm_low_rpm_1,         1, 0) \
+    DEBUG_RECORD_FIELD(alarm_low_rpm_2,         1, 0) \
+    DEBUG_RECORD_FIELD(alarm_high_rpm_1,        1, 0) \
+    DEBUG_RECORD_FIELD(alarm_high_rpm_2,        1, 0) \
+    DEBUG_RECORD_FIELD(alarm_fail_start,        1, 0) \
+    DEBUG_RECORD_FIELD(alarm_fail_stop,         1, 0) \
+    DEBUG_RECORD_FIELD(alarm_e_stop,            1, 0) \
+    DEBUG_RECORD_FIELD(alarm_maintenance,       1, 0) \
+    DEBUG_RECORD_FIELD(alarm_user_dig_1,        1, 0) \
+    DEBUG_RECORD_FIELD(alarm_user_dig_2,        1, 0) \
+    DEBUG_RECORD_FIELD(alarm_user_an,           1, 0) \
+    DEBUG_RECORD_FIELD(pic_com_state,           1, 0)
+
+// The record as byte arrays, there is no padding between the fields
+#define DEBUG_RECORD_FIELD(name, size, sign)  uint8_t name[size];
+typedef struct {
+    DEBUG_RECORD_FIELDS
+} debug_record_t;
+#undef DEBUG_RECORD_FIELD
+
+#define DEBUG_RECORD_SIZE   sizeof(debug_record_t)
+
+// Size of a frame before COBS encoding, the record frame is the largest frame
+#define DEBUG_FRAME_SIZE    (DEBUG_FRAME_HEADER_SIZE + DEBUG_RECORD_SIZE + DEBUG_FRAME_CRC_SIZE)
+
+// Largest trace frame before COBS encoding, a 32 bit LEB128 number takes up to 5 bytes
+#define DEBUG_TRACE_FRAME_SIZE(args)    (DEBUG_FRAME_HEADER_SIZE + 5 * (args) + DEBUG_FRAME_CRC_SIZE)
+
+
+#endif
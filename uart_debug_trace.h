@@ -0,0 +1,51 @@
+#ifndef UART_DEBUG_TRACE_H
+#define UART_DEBUG_TRACE_H
+
+/*
+ * Trace dictionary, the format of every message that is logged with DEBUG_TRACE.
+ * Shared between the firmware and the host decoder (tools/debug_decode.c).
+ *
+ * In UART_DEBUG_MODE_TRACE only the message id and the raw arguments are sent,
+ * the host rebuilds the text from this table. In the other modes the firmware
+ * formats the message itself with debug_printf.
+ *
+ * All arguments are sent as 32 bit values, so every conversion must use the 'l'
+ * modifier: %lu %ld %lx %lX %lc. %s is not supported.
+ * Values in scaled units are printed as fixed point with a precision, %.1lu of a
+ * value in 100 mV prints volts (see utl_vsnprintf). The raw value is still sent.
+ * Add new messages at the end, the position in the list is the id on the wire.
+ */
+
+#define DEBUG_TRACE_MAX_ARGS    10
+
+// DEBUG_TRACE_MESSAGE(id, format)
+#define DEBUG_TRACE_MESSAGES \
+    DEBUG_TRACE_MESSAGE(TRACE_BUTTON,           "Button: %lu%lu%lu%lu%lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_DIG_SENSOR,       "Dig sensor closed: %lu%lu%lu%lu activated: %lu%lu%lu%lu - alt: %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_E_STOP,           "E stop closed: %lu activated: %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_ANALOG_SENSOR,    "Analog sensor res: %lu %lu %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_PT100,            "PT100: %lu %.1ld %.1ld %.1ld\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_BATTERY,          "Battery: %.3lu V %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_GENERATOR_V,      "Generator V: %.1lu %.1lu %.1lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_GENERATOR_A,      "Generator A: %.1lu %.1lu %.1lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_GENERATOR_VA,     "Generator VA: %lu %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_GENERATOR,        "Generator: %.2lu Hz %lu RPM %lu VA\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_SENSOR_ALARM,     "Sensor alarm: %lu %lu %lu %lu %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_GENERATOR_ALARM,  "Generator alarm: %lu %lu %lu %lu %lu %lu %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_ENGINE_ALARM,     "Engine alarm: %lu %lu %lu %lu %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_ECU_ALARM,        "ECU alarm: %lu %lu %lu %lu %lu %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_PIC_COM_STATE,    "PIC com state: %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_DEBUG_BUFFER,     "Debug buf: max %lu %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_DEBUG_CYCLES,     "Debug cyc: isr %lu %lu prod %lu %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_DEBUG_ALARM,      "Debug alarm: %lu wait max %lu sum %lu\r\n") \
+    DEBUG_TRACE_MESSAGE(TRACE_DEBUG_QUEUE,      "Debug q: in %lu out %lu drop %lu %lu\r\n")
+
+#define DEBUG_TRACE_MESSAGE(id, format)     id,
+typedef enum {
+    DEBUG_TRACE_MESSAGES
+    DEBUG_TRACE_COUNT
+} debug_trace_id_t;
+#undef DEBUG_TRACE_MESSAGE
+
+
+#endif
@@ -1,8 +1,195 @@
 #include "utl.h"
 #include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
 
 static const char hex_chars[] = "0123456789ABCDEF";
+static const char hex_chars_lower[] = "0123456789abcdef";
+// 10^n for the fixed point conversions
+static const uint32_t pow10_table[10] = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL
+};
+// "00".."99", two characters for every value below 100
+static const char dec_pairs[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
+// Bits per digit for the radices with a shift/mask fast path, 0 for the others
+static uint8_t radix_shift(uint8_t radix) {
+    switch (radix) {
+        case 2:  return 1;
+        case 8:  return 3;
+        case 16: return 4;
+        default: return 0;
+    }
+}
+
+
+// Number of digits of value in a power of two radix with shift bits per digit
+static uint8_t pow2_digits(uint32_t value, uint8_t shift) {
+    uint8_t digits, max_digits;
+
+    max_digits = (32 + shift - 1) / shift;
+    digits = 1;
+    while (digits < max_digits && (value >> (digits * shift)) != 0) {
+        digits++;
+    }
+    return digits;
+}
+
+// Writes exactly digits characters of value, right aligned and zero padded, no null character
+static void pow2_write(uint32_t value, char *str, uint8_t shift, uint8_t digits, const char *chars) {
+    uint8_t mask;
+
+    mask = (1 << shift) - 1;
+    str += digits;
+    while (digits--) {
+        *--str = chars[value & mask];
+        value >>= shift;
+    }
+}
+
+/*
+ * Function:        char *utl_ui32toa_pow2(uint32_t value, char *str, uint8_t shift, uint8_t width, const char *chars)
+ * 
+ * Description:     Converts an 32 bit unsigned integer to a null terminated string
+ *                  in a power of two radix, using only shifts and masks.
+ *                  The string is padded with 0 to at least width digits.
+ *                  Returns max UTL_POW2_MAX_WIDTH chars
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to a string buffer
+ *                  uint8_t shift       Bits per digit (1->bin, 3->oct, 4->hex)
+ *                  uint8_t width       Minimum number of digits, 0 for no padding
+ *                  const char *chars   Digit characters (hex_chars or hex_chars_lower)
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+static char *utl_ui32toa_pow2(uint32_t value, char *str, uint8_t shift, uint8_t width, const char *chars) {
+    uint8_t digits;
+
+    digits = pow2_digits(value, shift);
+    if (width > UTL_POW2_MAX_WIDTH) {
+        width = UTL_POW2_MAX_WIDTH;
+    }
+    if (digits < width) {                   // Zero padding
+        digits = width;
+    }
+    pow2_write(value, str, shift, digits, chars);
+    str[digits] = '\0';
+    return str + digits;
+}
+
+/*
+ * Function:        char *utl_ui32toa_hex(uint32_t value, char *str, uint8_t width, uint8_t lowercase)
+ * 
+ * Description:     Converts an 32 bit unsigned integer to a null terminated hex string
+ *                  padded with 0 to at least width digits (utl_ui32toa_hex(x, s, 8, 0) -> "%08X")
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to a string buffer
+ *                  uint8_t width       Minimum number of digits, 0 for no padding
+ *                  uint8_t lowercase   UTL_LOWERCASE for a-f, UTL_UPPERCASE for A-F
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_ui32toa_hex(uint32_t value, char *str, uint8_t width, uint8_t lowercase) {
+    return utl_ui32toa_pow2(value, str, 4, width, lowercase ? hex_chars_lower : hex_chars);
+}
+
+/*
+ * Function:        uint8_t utl_hex_digits(uint32_t value)
+ * 
+ * Description:     Counts the hex digits of a 32 bit unsigned integer
+ * 
+ * Parameters:      uint32_t value      The value to count
+ *
+ * Returns:         uint8_t             Number of digits (1 to 8)
+ */
+uint8_t utl_hex_digits(uint32_t value) {
+    return pow2_digits(value, 4);
+}
+
+/*
+ * Function:        void utl_ui32toa_hex_fixed(uint32_t value, char *str, uint8_t digits, uint8_t lowercase)
+ * 
+ * Description:     Writes exactly digits hex characters of an 32 bit unsigned integer,
+ *                  zero padded and without a null character.
+ *                  Used to write straight into a buffer that must not be overwritten after the digits.
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to the first character to write
+ *                  uint8_t digits      Number of characters to write
+ *                  uint8_t lowercase   UTL_LOWERCASE for a-f, UTL_UPPERCASE for A-F
+ *
+ * Returns:         None
+ */
+void utl_ui32toa_hex_fixed(uint32_t value, char *str, uint8_t digits, uint8_t lowercase) {
+    pow2_write(value, str, 4, digits, lowercase ? hex_chars_lower : hex_chars);
+}
+
+/*
+ * Function:        char *utl_ui32toa_oct(uint32_t value, char *str, uint8_t width)
+ * 
+ * Description:     Converts an 32 bit unsigned integer to a null terminated octal string
+ *                  padded with 0 to at least width digits
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to a string buffer
+ *                  uint8_t width       Minimum number of digits, 0 for no padding
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_ui32toa_oct(uint32_t value, char *str, uint8_t width) {
+    return utl_ui32toa_pow2(value, str, 3, width, hex_chars);
+}
+
+/*
+ * Function:        char *utl_ui32toa_bin(uint32_t value, char *str, uint8_t width)
+ * 
+ * Description:     Converts an 32 bit unsigned integer to a null terminated binary string
+ *                  padded with 0 to at least width digits
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to a string buffer
+ *                  uint8_t width       Minimum number of digits, 0 for no padding
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_ui32toa_bin(uint32_t value, char *str, uint8_t width) {
+    return utl_ui32toa_pow2(value, str, 1, width, hex_chars);
+}
+
+// Splits a 64 bit value in 16 bit limbs, most significant first
+static void u64_to_limbs(uint64_t value, uint16_t *limb) {
+    uint32_t half;
+
+    half = (uint32_t)(value >> 32);
+    limb[0] = (uint16_t)(half >> 16);
+    limb[1] = (uint16_t)half;
+    half = (uint32_t)value;
+    limb[2] = (uint16_t)(half >> 16);
+    limb[3] = (uint16_t)half;
+}
+
+// Divides the limbs in place by divisor and returns the remainder. Every step is
+// a 32/16 bit division (one DIV.UD on the dsPIC), instead of a 64 bit library division.
+static uint16_t u64_div16(uint16_t *limb, uint16_t divisor) {
+    uint32_t part;
+    uint16_t rest;
+    uint8_t i;
+
+    rest = 0;
+    for (i = 0; i < 4; i++) {
+        part = ((uint32_t)rest << 16) | limb[i];
+        limb[i] = (uint16_t)(part / divisor);
+        rest = (uint16_t)(part - (uint32_t)limb[i] * divisor);
+    }
+    return rest;
+}
 
 /*
  * Function:        char *utl_itoa(int value, char *str, uint8_t radix)
@@ -25,6 +212,10 @@ char *utl_itoa(int value, char *str, uint8_t radix)
 
   ptr=str;                        // save string ptr   
 
+  if (radix_shift(radix)) {       // power of two radix
+    utl_ui32toa_pow2((uint16_t)value, str, radix_shift(radix), 0, hex_chars);
+    return (ptr);
+  }
   if (radix < 2 || radix > 16)    // wrong radix       
     return (ptr);
 
@@ -73,6 +264,10 @@ char *utl_uitoa(unsigned int value, char *str, uint8_t radix)
 
   ptr=str;                        // save string ptr
 
+  if (radix_shift(radix)) {       // power of two radix
+    utl_ui32toa_pow2((uint16_t)value, str, radix_shift(radix), 0, hex_chars);
+    return (ptr);
+  }
   if (radix < 2 || radix > 16)    // wrong radix
     return (ptr);
 
@@ -134,17 +329,19 @@ char *utl_ultoa(unsigned long value, char *string, uint8_t radix)
     value = lnew;
   } while (value != 0);
   windex--;
-  for (lnew = windex ; lnew != 0xFFFFFFFF ; --lnew)   /* swap LSB MSB     */
+  for (lnew = windex ; lnew != (unsigned long)-1 ; --lnew)   /* swap LSB MSB     */
     *string++ = temp[lnew];
   *string = '\0';
   return (ptr);
 }
 
 /*
- * Function:        char *utl_lltoa(long value, char *str, uint8_t radix)
+ * Function:        char *utl_lltoa(long long value, char *str, uint8_t radix)
  * 
- * Description:     Converts a long long integer to a null terminated string
- *                  Returns max 32 chars
+ * Description:     Converts a 64 bit integer to a null terminated string
+ *                  Negative values get a '-' in radix 10, other radices show
+ *                  the 64 bit two's complement. No 64 bit division is used.
+ *                  Returns max 64 chars
  * 
  * Parameters:      long long value    The value to convert
  *                  char *str          Pointer to a string buffer
@@ -152,45 +349,435 @@ char *utl_ultoa(unsigned long value, char *string, uint8_t radix)
  *
  * Returns:         char *             Pointer to the string buffer
  */
-char *utl_lltoa(long val, char *s, uint8_t radix)
-{ 
-  char *p,t;
-  uint8_t ch;
-  uint16_t l,rd;
+char *utl_lltoa(long long value, char *str, uint8_t radix) {
+    char temp[48];
+    uint16_t limb[4];
+    uint32_t high;
+    uint8_t index, shift;
+    char *ptr;
 
-  if (val < 0 && radix == 10)     /* negative number ? */
-  {                               /* and radix 10      */
-    val = -val;
-    *s++ = '-';
-  }
-  l = val;
-  rd = radix;
-  p=s;
-  do
-  {
-//    ch= (BYTE) ((val % radix) & 0x0f);
-    ch= (uint8_t) ((l % rd) & 0x0f);
-    if (ch>=10)
-      *p= (char)(ch)+55; /* -10+'A';*/
-    else
-      *p= (char)(ch)+'0';
-    p++;
-//    val = val / radix;
-    l = l / rd;
-//  } while (val);
-  } while (l);
-  *p='\0';
-  p--; ch=0;
-  while (p>(s+ch))  /* the converted string is turned around! */
-  {
-    t= *p;
-    *p= s[ch];
-    s[ch]=t;
-    ch++; p--;
-  }
-  return(s);
+    ptr = str;                              // Save string ptr
+    if (radix == 10) {                      // Decimal fast path
+        utl_i64toa(value, str);
+        return ptr;
+    }
+    shift = radix_shift(radix);
+    if (shift == 1 || shift == 4) {         // Bin and hex, two 32 bit halves
+        high = (uint32_t)((uint64_t)value >> 32);
+        if (high != 0) {
+            str = utl_ui32toa_pow2(high, str, shift, 0, hex_chars);
+            utl_ui32toa_pow2((uint32_t)value, str, shift, 32 / shift, hex_chars);
+        } else {
+            utl_ui32toa_pow2((uint32_t)value, str, shift, 0, hex_chars);
+        }
+        return ptr;
+    }
+    if (radix < 2 || radix > 16) {          // Wrong radix
+        return ptr;
+    }
+    u64_to_limbs((uint64_t)value, limb);
+    index = 0;                              // Do conversion, rest is char LSB first
+    do {
+        temp[index++] = hex_chars[u64_div16(limb, radix)];
+    } while ((limb[0] | limb[1] | limb[2] | limb[3]) != 0);
+
+    while (index != 0) {                    // Swap LSB MSB
+        *str++ = temp[--index];
+    }
+    *str = '\0';
+    return ptr;
+}
+
+/*
+ * Function:        uint8_t utl_dec_digits(uint32_t value)
+ * 
+ * Description:     Counts the decimal digits of a 32 bit unsigned integer
+ * 
+ * Parameters:      uint32_t value      The value to count
+ *
+ * Returns:         uint8_t             Number of digits (1 to 10)
+ */
+uint8_t utl_dec_digits(uint32_t value) {
+    if (value < 10000UL) {
+        if (value < 100) return (value < 10) ? 1 : 2;
+        return (value < 1000) ? 3 : 4;
+    }
+    if (value < 100000000UL) {
+        if (value < 1000000UL) return (value < 100000UL) ? 5 : 6;
+        return (value < 10000000UL) ? 7 : 8;
+    }
+    return (value < 1000000000UL) ? 9 : 10;
+}
+
+/*
+ * Function:        void utl_ui32toa_fixed(uint32_t value, char *str, uint8_t digits)
+ * 
+ * Description:     Writes exactly digits decimal characters of an 32 bit unsigned integer,
+ *                  zero padded and without a null character.
+ *                  The digits are written in place two at a time, no reverse pass is needed.
+ *                  Divisions are done on 16 bit as soon as the value fits.
+ *                  digits must be at least utl_dec_digits(value)
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to the first character to write
+ *                  uint8_t digits      Number of characters to write
+ *
+ * Returns:         None
+ */
+void utl_ui32toa_fixed(uint32_t value, char *str, uint8_t digits) {
+    char *ptr;
+    uint32_t q;
+    uint16_t low, q16;
+    uint8_t pair;
+
+    ptr = str + digits;
+    while (value > 0xFFFF) {                // 32 bit part
+        q = value / 100;
+        pair = (uint8_t)(value - q * 100) << 1;
+        *--ptr = dec_pairs[pair + 1];
+        *--ptr = dec_pairs[pair];
+        value = q;
+    }
+    low = (uint16_t)value;
+    while (low >= 100) {                    // 16 bit part
+        q16 = low / 100;
+        pair = (uint8_t)(low - q16 * 100) << 1;
+        *--ptr = dec_pairs[pair + 1];
+        *--ptr = dec_pairs[pair];
+        low = q16;
+    }
+    if (low >= 10) {                        // Last one or two digits
+        pair = (uint8_t)low << 1;
+        *--ptr = dec_pairs[pair + 1];
+        *--ptr = dec_pairs[pair];
+    } else {
+        *--ptr = (char)('0' + low);
+    }
+    while (ptr != str) {                    // Zero padding
+        *--ptr = '0';
+    }
+}
+
+/*
+ * Function:        char *utl_ui32toa_dec(uint32_t value, char *str)
+ * 
+ * Description:     Converts an 32 bit unsigned integer to a null terminated decimal string
+ *                  Returns max 10 chars
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to a string buffer
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_ui32toa_dec(uint32_t value, char *str) {
+    uint8_t digits;
+
+    digits = utl_dec_digits(value);
+    utl_ui32toa_fixed(value, str, digits);
+    str[digits] = '\0';
+    return str + digits;
+}
+
+/*
+ * Function:        char *utl_i32toa_dec(int32_t value, char *str)
+ * 
+ * Description:     Converts an 32 bit integer to a null terminated decimal string
+ *                  Returns max 11 chars
+ * 
+ * Parameters:      int32_t value       The value to convert
+ *                  char *str           Pointer to a string buffer
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_i32toa_dec(int32_t value, char *str) {
+    if (value < 0) {
+        *str++ = '-';
+        return utl_ui32toa_dec(0UL - (uint32_t)value, str);
+    }
+    return utl_ui32toa_dec((uint32_t)value, str);
+}
+
+/*
+ * Function:        char *utl_u64toa(uint64_t value, char *str)
+ * 
+ * Description:     Converts a 64 bit unsigned integer to a null terminated decimal string
+ *                  The value is split in base 10^8 chunks with 16 bit limb divisions,
+ *                  each chunk is written by utl_ui32toa_fixed on 32 and 16 bit.
+ *                  Returns max 20 chars
+ * 
+ * Parameters:      uint64_t value      The value to convert
+ *                  char *str           Pointer to a string buffer
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_u64toa(uint64_t value, char *str) {
+    uint32_t chunk[2];
+    uint16_t limb[4], low;
+    uint8_t chunks;
+
+    if ((value >> 32) == 0) {               // Fits 32 bit
+        return utl_ui32toa_dec((uint32_t)value, str);
+    }
+    u64_to_limbs(value, limb);
+    chunks = 0;
+    while ((limb[0] | limb[1]) != 0) {      // At most 2 chunks, 2^64 / 10^16 fits 32 bit
+        low = u64_div16(limb, 10000);
+        chunk[chunks++] = (uint32_t)u64_div16(limb, 10000) * 10000 + low;
+    }
+    str = utl_ui32toa_dec(((uint32_t)limb[2] << 16) | limb[3], str);
+    while (chunks != 0) {                   // Chunks are zero padded to 8 digits
+        utl_ui32toa_fixed(chunk[--chunks], str, 8);
+        str += 8;
+    }
+    *str = '\0';
+    return str;
+}
+
+/*
+ * Function:        char *utl_i64toa(int64_t value, char *str)
+ * 
+ * Description:     Converts a 64 bit integer to a null terminated decimal string
+ *                  Returns max 20 chars
+ * 
+ * Parameters:      int64_t value       The value to convert
+ *                  char *str           Pointer to a string buffer
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_i64toa(int64_t value, char *str) {
+    if (value < 0) {
+        *str++ = '-';
+        return utl_u64toa(0ULL - (uint64_t)value, str);
+    }
+    return utl_u64toa((uint64_t)value, str);
+}
+
+// Fixed point core of utl_ufixtoa and utl_fixtoa, the '-' is only written
+// when the rounded value is not 0
+static char *fix_write(uint32_t value, char *str, uint8_t scale_pow10, uint8_t decimals, uint8_t negative) {
+    uint32_t div, q;
+    uint8_t digits, shown, zeros, pair, i;
+    char *ptr, *end;
+
+    if (scale_pow10 > 9) scale_pow10 = 9;
+    if (decimals > 9) decimals = 9;
+    if (decimals < scale_pow10) {           // Round half away from zero
+        div = pow10_table[scale_pow10 - decimals];
+        if (value <= 0xFFFF) {              // 16 bit division when it fits
+            q = (uint16_t)value / (uint16_t)div;
+        } else {
+            q = value / div;
+        }
+        value = q + (value - q * div >= div / 2);
+        shown = decimals;
+        zeros = 0;
+    } else {
+        shown = scale_pow10;
+        zeros = decimals - scale_pow10;
+    }
+    if (negative && value != 0) {
+        *str++ = '-';
+    }
+    digits = utl_dec_digits(value);
+    if (digits <= shown) {                  // Leading "0."
+        digits = shown + 1;
+    }
+    digits -= shown;                        // Integer digits
+    end = str + digits + decimals + (decimals != 0);
+    *end = '\0';
+    ptr = end;
+    while (zeros--) {                       // Padding decimals
+        *--ptr = '0';
+    }
+    for (i = shown; i >= 2; i -= 2) {       // Shown decimals, two at a time from the back
+        q = value / 100;
+        pair = (uint8_t)(value - q * 100) << 1;
+        *--ptr = dec_pairs[pair + 1];
+        *--ptr = dec_pairs[pair];
+        value = q;
+    }
+    if (i != 0) {
+        q = value / 10;
+        *--ptr = (char)('0' + (uint8_t)(value - q * 10));
+        value = q;
+    }
+    if (decimals != 0) {
+        *--ptr = '.';
+    }
+    while (value >= 100) {                  // Integer part in front of the point
+        q = value / 100;
+        pair = (uint8_t)(value - q * 100) << 1;
+        *--ptr = dec_pairs[pair + 1];
+        *--ptr = dec_pairs[pair];
+        value = q;
+    }
+    if (value >= 10) {
+        pair = (uint8_t)value << 1;
+        *--ptr = dec_pairs[pair + 1];
+        *--ptr = dec_pairs[pair];
+    } else {
+        *--ptr = (char)('0' + (uint8_t)value);
+    }
+    return end;
+}
+
+/*
+ * Function:        char *utl_ufixtoa(uint32_t value, char *str, uint8_t scale_pow10, uint8_t decimals)
+ * 
+ * Description:     Converts a fixed point value to a null terminated decimal string.
+ *                  value is in units of 10^-scale_pow10, e.g. 2305 in 100 mV with
+ *                  scale_pow10 1 gives "230.5". Fewer decimals than scale_pow10 are
+ *                  rounded half away from zero, more are padded with 0.
+ *                  The decimals and the integer part are written from the back with the
+ *                  digit pair table, plus one division when rounding.
+ *                  Returns max 20 chars
+ * 
+ * Parameters:      uint32_t value      The value to convert
+ *                  char *str           Pointer to a string buffer
+ *                  uint8_t scale_pow10 Decimals in value, 0 to 9
+ *                  uint8_t decimals    Decimals to write, 0 to 9
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_ufixtoa(uint32_t value, char *str, uint8_t scale_pow10, uint8_t decimals) {
+    return fix_write(value, str, scale_pow10, decimals, 0);
+}
+
+/*
+ * Function:        char *utl_fixtoa(int32_t value, char *str, uint8_t scale_pow10, uint8_t decimals)
+ * 
+ * Description:     Converts a signed fixed point value to a null terminated decimal string,
+ *                  see utl_ufixtoa. A value that rounds to 0 has no '-'.
+ *                  Returns max 21 chars
+ * 
+ * Parameters:      int32_t value       The value to convert
+ *                  char *str           Pointer to a string buffer
+ *                  uint8_t scale_pow10 Decimals in value, 0 to 9
+ *                  uint8_t decimals    Decimals to write, 0 to 9
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_fixtoa(int32_t value, char *str, uint8_t scale_pow10, uint8_t decimals) {
+    if (value < 0) {
+        return fix_write(0UL - (uint32_t)value, str, scale_pow10, decimals, 1);
+    }
+    return fix_write((uint32_t)value, str, scale_pow10, decimals, 0);
+}
+
+// Smallest magnitude that shows as 1000 or more with scale_pow10 and decimals,
+// values just below 1000 units round up to it
+static uint32_t si_limit(uint8_t scale_pow10, uint8_t decimals) {
+    uint32_t limit;
+
+    limit = pow10_table[scale_pow10 + 3];
+    if (decimals < scale_pow10) {
+        limit -= pow10_table[scale_pow10 - decimals] / 2;
+    }
+    return limit;
+}
+
+/*
+ * Function:        char *utl_fixtoa_si(int32_t value, char *str, uint8_t scale_pow10, uint8_t decimals)
+ * 
+ * Description:     Like utl_fixtoa, with a 'k' or 'M' prefix when the value is at
+ *                  least 1000 or 1000000 units after rounding, e.g. 8840 VA with decimals 1 gives "8.8k"
+ *                  Returns max 22 chars
+ * 
+ * Parameters:      int32_t value       The value to convert
+ *                  char *str           Pointer to a string buffer
+ *                  uint8_t scale_pow10 Decimals in value, 0 to 9
+ *                  uint8_t decimals    Decimals to write, 0 to 9
+ *
+ * Returns:         char *              Pointer to the terminating null character
+ */
+char *utl_fixtoa_si(int32_t value, char *str, uint8_t scale_pow10, uint8_t decimals) {
+    uint32_t magnitude;
+    char prefix;
+
+    magnitude = (value < 0) ? 0UL - (uint32_t)value : (uint32_t)value;
+    prefix = '\0';
+    if (scale_pow10 <= 3 && magnitude >= si_limit(scale_pow10 + 3, decimals)) {
+        scale_pow10 += 6;
+        prefix = 'M';
+    } else if (scale_pow10 <= 6 && magnitude >= si_limit(scale_pow10, decimals)) {
+        scale_pow10 += 3;
+        prefix = 'k';
+    }
+    str = utl_fixtoa(value, str, scale_pow10, decimals);
+    if (prefix != '\0') {
+        *str++ = prefix;
+        *str = '\0';
+    }
+    return str;
+}
+
+// Writes value below 100 as two characters from the pair table
+static void put_pair(char *str, uint8_t value) {
+    if (value > 99) {
+        value = 99;
+    }
+    str[0] = dec_pairs[2 * value];
+    str[1] = dec_pairs[2 * value + 1];
+}
+
+/*
+ * Function:        void utl_datetime_init(utl_datetime_t *datetime)
+ * 
+ * Description:     Clears the cache of utl_datetime, the next call writes all fields
+ * 
+ * Parameters:      utl_datetime_t *datetime    The cache to clear
+ *
+ * Returns:         None
+ */
+void utl_datetime_init(utl_datetime_t *datetime) {
+    memcpy(datetime->text, "0000-00-00 00:00:00", UTL_DATETIME_LENGTH + 1);
+    datetime->date = 0xFFFFFFFFUL;
+    datetime->hour_min = 0xFFFF;
 }
 
+/*
+ * Function:        const char *utl_datetime(utl_datetime_t *datetime, uint16_t year, uint8_t month, uint8_t day,
+ *                                           uint8_t hour, uint8_t min, uint8_t sec)
+ * 
+ * Description:     Formats a date and time as "YYYY-MM-DD hh:mm:ss", zero padded.
+ *                  The date and the hour:minute part are only written again when they
+ *                  changed since the last call with this cache, the seconds every time.
+ *                  Each field is copied from the pair table, only the year is split in
+ *                  two pairs with a division by 100, once per day.
+ *                  Fields above their width are written as 99 (9999 for the year).
+ * 
+ * Parameters:      utl_datetime_t *datetime    Cache with the text of the last call
+ *                  uint16_t year               Full year, e.g. 2024
+ *                  uint8_t month, day          1 based
+ *                  uint8_t hour, min, sec
+ *
+ * Returns:         const char *                The null terminated text in the cache
+ */
+const char *utl_datetime(utl_datetime_t *datetime, uint16_t year, uint8_t month, uint8_t day,
+                         uint8_t hour, uint8_t min, uint8_t sec) {
+    uint32_t date;
+    uint16_t hour_min;
+
+    date = ((uint32_t)year << 16) | ((uint16_t)month << 8) | day;
+    if (date != datetime->date) {
+        datetime->date = date;
+        if (year > 9999) {
+            year = 9999;
+        }
+        put_pair(&datetime->text[0], (uint8_t)(year / 100));
+        put_pair(&datetime->text[2], (uint8_t)(year % 100));
+        put_pair(&datetime->text[5], month);
+        put_pair(&datetime->text[8], day);
+    }
+    hour_min = ((uint16_t)hour << 8) | min;
+    if (hour_min != datetime->hour_min) {
+        datetime->hour_min = hour_min;
+        put_pair(&datetime->text[11], hour);
+        put_pair(&datetime->text[14], min);
+    }
+    put_pair(&datetime->text[17], sec);
+    return datetime->text;
+}
 
 /*
  * Function:        char *utl_i32toa(int32_t value, char *str, uint8_t radix)
@@ -211,6 +798,10 @@ char *utl_i32toa(int32_t value, char *str, uint8_t radix) {
     int8_t i;
 
     ptr=str;                                // Save string ptr
+    if (radix == 10) {                      // Decimal fast path
+        utl_i32toa_dec(value, str);
+        return ptr;
+    }
     if (radix < 2 || radix > 16) {          // Wrong radix
         return ptr;
     }
@@ -218,6 +809,10 @@ char *utl_i32toa(int32_t value, char *str, uint8_t radix) {
         value = -value;
         *str++ = '-';
     }
+    if (radix_shift(radix)) {               // Power of two radix
+        utl_ui32toa_pow2((uint32_t)value, str, radix_shift(radix), 0, hex_chars);
+        return ptr;
+    }
 
     index = 0;                              // Do conversion
     do {
@@ -253,6 +848,14 @@ char *utl_ui32toa(uint32_t value, char *str, uint8_t radix) {
     int8_t i;
 
     ptr=str;                                // Save string ptr
+    if (radix == 10) {                      // Decimal fast path
+        utl_ui32toa_dec(value, str);
+        return ptr;
+    }
+    if (radix_shift(radix)) {               // Power of two radix
+        utl_ui32toa_pow2(value, str, radix_shift(radix), 0, hex_chars);
+        return ptr;
+    }
     if (radix < 2 || radix > 16) {          // Wrong radix
         return ptr;
     }
@@ -296,6 +899,11 @@ char *utl_itoa_l(int value, char *str, uint8_t radix, uint8_t len)
   if (len>8)
     return (ptr);                 // wrong length
 
+  if (radix_shift(radix)) {       // power of two radix
+    utl_ui32toa_pow2((uint16_t)value, str, radix_shift(radix), len, hex_chars);
+    return (ptr);
+  }
+
   if (radix < 2 || radix > 16)    /* wrong radix       */
     return (ptr);
 
@@ -311,7 +919,7 @@ char *utl_itoa_l(int value, char *str, uint8_t radix, uint8_t len)
   {
     n = (uint16_t) ((uint16_t)(value) / radix);
 //    rest = (WORD) ((WORD)(value) % radix);      /* rest is char LSB first */
-    rest = value - (radix*(value/radix));
+    rest = (uint16_t)(value) - radix * n;      /* rest from the unsigned quotient */
     temp[index++] = hex_chars[rest];
     value = n;
   } while (value != 0);
@@ -345,6 +953,10 @@ char *utl_i32toa_l(uint32_t value, char *str, uint8_t radix, uint8_t len) {
     int8_t i;
 
     ptr=str;                                // Save string ptr
+    if (radix_shift(radix)) {               // Power of two radix
+        utl_ui32toa_pow2(value, str, radix_shift(radix), len, hex_chars);
+        return ptr;
+    }
     if (radix < 2 || radix > 16) {          // Wrong radix
         return ptr;
     }
@@ -366,6 +978,169 @@ char *utl_i32toa_l(uint32_t value, char *str, uint8_t radix, uint8_t len) {
     return ptr;
 }
 
+/*
+ * Function:        int utl_vsnprintf(char *str, uint16_t size, const char *fmt, va_list args)
+ * 
+ * Description:     Formats a string like vsnprintf, without heap and with a fixed stack use.
+ *                  Supported:  %d %u %x %X %c %s %%
+ *                  Flags:      '-' left align, '0' zero padding, width (digits)
+ *                  Precision:  '.' and a digit on %d and %u, the argument is a fixed point
+ *                              value with that many decimals: %.1lu of 2305 -> "230.5".
+ *                              This is not the C meaning (minimum number of digits).
+ *                  Length:     'l' the argument is a 32 bit int32_t/uint32_t,
+ *                              without it the argument is an int/unsigned int
+ *                  The output is truncated to size-1 chars and always null terminated.
+ * 
+ * Parameters:      char *str           Pointer to a string buffer
+ *                  uint16_t size       Size of the string buffer
+ *                  const char *fmt     Format string
+ *                  va_list args        The arguments
+ *
+ * Returns:         int                 Number of chars written, without the null character
+ */
+int utl_vsnprintf(char *str, uint16_t size, const char *fmt, va_list args) {
+    char num[24];
+    const char *src;
+    uint16_t pos, len, pad;
+    uint8_t left, zero, is_long, width, decimals;
+    int32_t value;
+    uint32_t uvalue;
+
+    if (size == 0) {
+        return 0;
+    }
+    size--;                                 // Room for the null character
+    pos = 0;
+    while (*fmt != '\0') {
+        if (*fmt != '%') {                  // Plain character
+            if (pos < size) str[pos++] = *fmt;
+            fmt++;
+            continue;
+        }
+        fmt++;
+        // Flags
+        left = 0;
+        zero = 0;
+        while (*fmt == '-' || *fmt == '0') {
+            if (*fmt == '-') left = 1;
+            else zero = 1;
+            fmt++;
+        }
+        // Width
+        width = 0;
+        while ('0' <= *fmt && *fmt <= '9') {
+            width = width * 10 + (*fmt - '0');
+            fmt++;
+        }
+        // Precision, decimals of a fixed point value
+        decimals = 0;
+        if (*fmt == '.') {
+            fmt++;
+            while ('0' <= *fmt && *fmt <= '9') {
+                decimals = decimals * 10 + (*fmt - '0');
+                fmt++;
+            }
+        }
+        // Length
+        is_long = 0;
+        if (*fmt == 'l') {
+            is_long = 1;
+            fmt++;
+        }
+        // Conversion
+        src = num;
+        switch (*fmt) {
+            case 'd':
+                if (is_long) value = va_arg(args, int32_t);
+                else value = va_arg(args, int);
+                if (decimals) len = utl_fixtoa(value, num, decimals, decimals) - num;
+                else len = utl_i32toa_dec(value, num) - num;
+                if (zero && !left && value < 0) {   // Sign before the zero padding
+                    if (pos < size) str[pos++] = '-';
+                    src++;
+                    len--;
+                    if (width) width--;
+                }
+                break;
+            case 'u':
+                if (is_long) uvalue = va_arg(args, uint32_t);
+                else uvalue = va_arg(args, unsigned int);
+                if (decimals) len = utl_ufixtoa(uvalue, num, decimals, decimals) - num;
+                else len = utl_ui32toa_dec(uvalue, num) - num;
+                break;
+            case 'x':
+            case 'X':
+                if (is_long) uvalue = va_arg(args, uint32_t);
+                else uvalue = va_arg(args, unsigned int);
+                len = utl_ui32toa_hex(uvalue, num, 0, *fmt == 'x') - num;
+                break;
+            case 'c':
+                num[0] = (char)va_arg(args, int);
+                len = 1;
+                zero = 0;
+                break;
+            case 's':
+                src = va_arg(args, const char *);
+                if (src == 0) src = "(null)";
+                for (len = 0; src[len] != '\0'; len++);
+                zero = 0;
+                break;
+            case '%':
+                num[0] = '%';
+                len = 1;
+                width = 0;
+                break;
+            case '\0':                      // Format ends after the '%'
+                str[pos] = '\0';
+                return pos;
+            default:                        // Unknown conversion, print it as is
+                num[0] = '%';
+                num[1] = *fmt;
+                len = 2;
+                width = 0;
+                break;
+        }
+        fmt++;
+        // Output with padding
+        pad = (width > len) ? width - len : 0;
+        if (!left) {
+            for ( ; pad != 0 ; pad--) {
+                if (pos < size) str[pos++] = zero ? '0' : ' ';
+            }
+        }
+        for ( ; len != 0 ; len--) {
+            if (pos < size) str[pos++] = *src;
+            src++;
+        }
+        for ( ; pad != 0 ; pad--) {
+            if (pos < size) str[pos++] = ' ';
+        }
+    }
+    str[pos] = '\0';
+    return pos;
+}
+
+/*
+ * Function:        int utl_snprintf(char *str, uint16_t size, const char *fmt, ...)
+ * 
+ * Description:     Formats a string, see utl_vsnprintf for the supported format
+ * 
+ * Parameters:      char *str           Pointer to a string buffer
+ *                  uint16_t size       Size of the string buffer
+ *                  const char *fmt     Format string
+ *
+ * Returns:         int                 Number of chars written, without the null character
+ */
+int utl_snprintf(char *str, uint16_t size, const char *fmt, ...) {
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = utl_vsnprintf(str, size, fmt, args);
+    va_end(args);
+    return len;
+}
+
 /*
  * Function:        int32_t utl_atoi32(char *str, uint8_t radix)
  * 
@@ -381,7 +1156,7 @@ int32_t utl_atoi32(char *str, uint8_t radix) {
     int32_t value = 0;
     uint8_t negative = 0;
     
-    if (radix < 2 || radix > 10) {          // Wrong radix
+    if (radix < 2 || radix > 16) {          // Wrong radix
         return 0;
     }
     if (*str == '-') {
@@ -392,9 +1167,11 @@ int32_t utl_atoi32(char *str, uint8_t radix) {
     while (*str != '\0') {
         temp = *str;
         // Convert char to int
-        if ('0'<=temp && temp<='9') temp -= '0';
-        else temp = 0;
-        if (temp > radix) temp = 0;
+        if      ('0'<=temp && temp<='9')    temp -= '0';
+        else if ('a'<=temp && temp<='f')    temp = temp - 'a' + 10;
+        else if ('A'<=temp && temp<='F')    temp = temp - 'A' + 10;
+        else                                temp = 0;
+        if (temp >= radix) temp = 0;
         // Add to value
         value *= radix;
         value += temp;
@@ -429,7 +1206,7 @@ uint32_t utl_atoui32(char *str, uint8_t radix) {
         else if ('A'<=temp && temp<='F')    temp = temp - 'A' + 10;
         else                                temp = 0;
         
-        if (temp > radix) temp = 0;
+        if (temp >= radix) temp = 0;
         // Add to value
         value *= radix;
         value += temp;
@@ -456,8 +1233,243 @@ int utl_hstoi(char *s)
   return(val);
 } 
 
+// UINT32_MAX / radix, the overflow limit of the parsers
+static const uint32_t parse_limit[17] = {
+    0x00000000UL, 0x00000000UL, 0x7FFFFFFFUL, 0x55555555UL, 0x3FFFFFFFUL, 0x33333333UL,
+    0x2AAAAAAAUL, 0x24924924UL, 0x1FFFFFFFUL, 0x1C71C71CUL, 0x19999999UL, 0x1745D174UL,
+    0x15555555UL, 0x13B13B13UL, 0x12492492UL, 0x11111111UL, 0x0FFFFFFFUL
+};
+
+// Value of a digit character, 0xFF for any other character
+static uint8_t digit_value(char c) {
+    if ('0' <= c && c <= '9') return c - '0';
+    if ('a' <= c && c <= 'f') return c - 'a' + 10;
+    if ('A' <= c && c <= 'F') return c - 'A' + 10;
+    return 0xFF;
+}
+
+#if UTL_PARSE_SWAR
+#define SWAR_ONES   0x0101010101010101ULL
+
+// Loads 8 characters, the first one in the low byte
+static uint64_t swar_load(const char *str) {
+    uint64_t chunk;
+
+    memcpy(&chunk, str, 8);
+    return chunk;
+}
+
+// Value of 8 decimal digits, or -1 when one of them is not a digit
+static int64_t swar_dec8(uint64_t chunk) {
+    if ((((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL)) {
+        return -1;
+    }
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);    // Pairs, in the low byte of every 16 bit
+    chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return (int64_t)chunk;
+}
+
+// Sets the high bit of every byte that is above low and below high, bytes below 0x80 only
+#define SWAR_BETWEEN(x, low, high) \
+    (((SWAR_ONES * (127 + (high)) - ((x) & SWAR_ONES * 127)) & ~(x) & \
+      (((x) & SWAR_ONES * 127) + SWAR_ONES * (127 - (low)))) & SWAR_ONES * 128)
+
+// Value of 8 hex digits, or -1 when one of them is not a hex digit
+static int64_t swar_hex8(uint64_t chunk) {
+    uint64_t valid;
+
+    valid = SWAR_BETWEEN(chunk, '0' - 1, '9' + 1) | SWAR_BETWEEN(chunk, 'A' - 1, 'F' + 1) |
+            SWAR_BETWEEN(chunk, 'a' - 1, 'f' + 1);
+    if ((chunk & SWAR_ONES * 128) != 0 || valid != SWAR_ONES * 128) {
+        return -1;
+    }
+    // Letters have bit 6 set and get 9 more than their low nibble
+    chunk = (chunk & SWAR_ONES * 0x0F) + ((chunk & SWAR_ONES * 0x40) >> 6) * 9;
+    // First character in the low byte is the most significant digit
+    chunk = ((chunk & 0x00FF00FF00FF00FFULL) << 4) | ((chunk >> 8) & 0x00FF00FF00FF00FFULL);
+    chunk = ((chunk & 0x0000FFFF0000FFFFULL) << 8) | ((chunk >> 16) & 0x0000FFFF0000FFFFULL);
+    chunk = ((chunk & 0x00000000FFFFFFFFULL) << 16) | (chunk >> 32);
+    return (int64_t)chunk;
+}
+#endif
+
+/*
+ * Function:        const char *utl_parse_u32(const char *str, uint16_t len, uint8_t radix, uint32_t *value, uint8_t *status)
+ * 
+ * Description:     Parses an unsigned integer from len characters, no null character is needed.
+ *                  Parsing stops at the first character that is not a digit of the radix,
+ *                  the caller can check the returned end pointer for trailing characters.
+ *                  Hex digits may be lower or upper case, there is no "0x" prefix.
+ *                  With UTL_PARSE_SWAR, radix 10 and 16 take 8 digits per step.
+ * 
+ * Parameters:      const char *str     Pointer to the first character
+ *                  uint16_t len        Number of characters available
+ *                  uint8_t radix       The radix to use for the conversion, 2 to 16
+ *                  uint32_t *value     Receives the value, UINT32_MAX on an overflow
+ *                                      and 0 when there are no digits
+ *                  uint8_t *status     Receives UTL_PARSE_OK, UTL_PARSE_INVALID (no digit
+ *                                      or wrong radix) or UTL_PARSE_OVERFLOW
+ *
+ * Returns:         const char *        Pointer to the first character after the digits
+ */
+const char *utl_parse_u32(const char *str, uint16_t len, uint8_t radix, uint32_t *value, uint8_t *status) {
+    const char *end;
+    uint32_t result, limit;
+    uint8_t digit, last, overflow;
+
+    *value = 0;
+    if (radix < 2 || radix > 16 || len == 0 || digit_value(*str) >= radix) {
+        *status = UTL_PARSE_INVALID;
+        return str;
+    }
+    end = str + len;
+    result = 0;
+    overflow = 0;
+#if UTL_PARSE_SWAR
+    if (radix == 10 || radix == 16) {
+        uint64_t wide = 0;
+        int64_t chunk;
+
+        while (end - str >= 8 && wide <= 0xFFFFFFFFULL) {
+            chunk = (radix == 10) ? swar_dec8(swar_load(str)) : swar_hex8(swar_load(str));
+            if (chunk < 0) {
+                break;
+            }
+            wide = (radix == 10) ? wide * 100000000ULL + (uint64_t)chunk : (wide << 32) | (uint64_t)chunk;
+            str += 8;
+        }
+        if (wide > 0xFFFFFFFFULL) {
+            overflow = 1;
+        } else {
+            result = (uint32_t)wide;
+        }
+    }
+#endif
+    limit = parse_limit[radix];
+    last = (uint8_t)(0xFFFFFFFFUL - limit * radix);
+    for ( ; str < end ; str++) {
+        digit = digit_value(*str);
+        if (digit >= radix) {
+            break;
+        }
+        if (result > limit || (result == limit && digit > last)) {
+            overflow = 1;                   // Keep going to the end of the digits
+        }
+        result = result * radix + digit;
+    }
+    if (overflow) {
+        *value = 0xFFFFFFFFUL;
+        *status = UTL_PARSE_OVERFLOW;
+    } else {
+        *value = result;
+        *status = UTL_PARSE_OK;
+    }
+    return str;
+}
+
+/*
+ * Function:        const char *utl_parse_i32(const char *str, uint16_t len, uint8_t radix, int32_t *value, uint8_t *status)
+ * 
+ * Description:     Parses an integer with an optional '-' or '+' from len characters,
+ *                  see utl_parse_u32. The range is INT32_MIN to INT32_MAX in every radix.
+ * 
+ * Parameters:      const char *str     Pointer to the first character
+ *                  uint16_t len        Number of characters available
+ *                  uint8_t radix       The radix to use for the conversion, 2 to 16
+ *                  int32_t *value      Receives the value, INT32_MIN or INT32_MAX on an
+ *                                      overflow and 0 when there are no digits
+ *                  uint8_t *status     Receives UTL_PARSE_OK, UTL_PARSE_INVALID or UTL_PARSE_OVERFLOW
+ *
+ * Returns:         const char *        Pointer to the first character after the digits,
+ *                                      str when there are no digits
+ */
+const char *utl_parse_i32(const char *str, uint16_t len, uint8_t radix, int32_t *value, uint8_t *status) {
+    const char *end;
+    uint32_t magnitude, max;
+    uint8_t negative;
+
+    negative = 0;
+    if (len != 0 && (*str == '-' || *str == '+')) {
+        negative = (*str == '-');
+        end = utl_parse_u32(str + 1, len - 1, radix, &magnitude, status);
+        if (*status == UTL_PARSE_INVALID) {
+            *value = 0;
+            return str;                     // A sign alone is not a number
+        }
+    } else {
+        end = utl_parse_u32(str, len, radix, &magnitude, status);
+    }
+    max = negative ? 0x80000000UL : 0x7FFFFFFFUL;
+    if (*status == UTL_PARSE_OVERFLOW || magnitude > max) {
+        *status = UTL_PARSE_OVERFLOW;
+        magnitude = max;
+    }
+    *value = negative ? (int32_t)(0UL - magnitude) : (int32_t)magnitude;
+    return end;
+}
+
 #define CRC_POLY_CRC16_CCITT 0x1021 // X^16 + X^12 + X^5 + 1
 
+#if UTL_CRC_METHOD == UTL_CRC_NIBBLE
+// CRC of a single nibble, indexed by (crc >> 12) ^ nibble
+static const uint16_t crc_table_16[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+#elif UTL_CRC_METHOD != UTL_CRC_BITWISE
+// CRC of a single byte, indexed by (crc >> 8) ^ byte
+static const uint16_t crc_table_256[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+#endif
+
+#if UTL_CRC_METHOD == UTL_CRC_SLICE_4 || UTL_CRC_METHOD == UTL_CRC_SLICE_8
+#if UTL_CRC_METHOD == UTL_CRC_SLICE_4
+#define CRC_SLICES  4
+#else
+#define CRC_SLICES  8
+#endif
+// crc_table_slice[k][x] is the CRC of byte x followed by k zero bytes.
+// Built from crc_table_256 by utl_crc_init() to keep the source readable.
+static uint16_t crc_table_slice[CRC_SLICES][256];
+static uint8_t crc_table_slice_ready = 0;
+#endif
+
+#if UTL_CRC_METHOD == UTL_CRC_BITWISE
 /**
  *     <b>Function prototype:</b><br>   static void hash_crc_16ccitt(WORD *crc,BYTE data)
  * <br>
@@ -484,6 +1496,123 @@ static void hash_crc_16ccitt(uint16_t *crc,uint8_t data) {
         }
     }
 }
+#endif
+
+/**
+ *     <b>Function prototype:</b><br>   UINT16 utl_crc_init(void)
+ * <br>
+ * <br><b>Description:</b><br>          Starts an incremental CRC 16 CCITT calculation.
+ * <br>                                 Builds the slicing tables on first use when
+ * <br>                                 UTL_CRC_SLICE_4 or UTL_CRC_SLICE_8 is selected.
+ * <br>
+ * <br><b>Precondition:</b><br>         None
+ * <br>
+ * <br><b>Inputs:</b><br>               None
+ * <br>
+ * <br><b>Outputs:</b><br>              The start value of the crc (UTL_CRC_SEED)
+ * <br>
+ * <br><b>Example:</b><br>              crc = utl_crc_init();
+ */
+uint16_t utl_crc_init(void) {
+#if UTL_CRC_METHOD == UTL_CRC_SLICE_4 || UTL_CRC_METHOD == UTL_CRC_SLICE_8
+    uint16_t i;
+    uint8_t k;
+
+    if (!crc_table_slice_ready) {
+        for (i = 0; i < 256; i++) {
+            crc_table_slice[0][i] = crc_table_256[i];
+        }
+        for (k = 1; k < CRC_SLICES; k++) {
+            for (i = 0; i < 256; i++) {
+                crc_table_slice[k][i] = (crc_table_slice[k-1][i] << 8) ^
+                                        crc_table_256[crc_table_slice[k-1][i] >> 8];
+            }
+        }
+        crc_table_slice_ready = 1;
+    }
+#endif
+    return UTL_CRC_SEED;
+}
+
+/**
+ *     <b>Function prototype:</b><br>   UINT16 utl_crc_update(UINT16 crc, UINT8 *pdata, UINT32 ui_size)
+ * <br>
+ * <br><b>Description:</b><br>          Adds a chunk of bytes to an incremental CRC 16 CCITT.
+ * <br>                                 A buffer can be split in any number of chunks,
+ * <br>                                 the result equals a single utl_calc_crc() call.
+ * <br>
+ * <br><b>Precondition:</b><br>         crc must be started with utl_crc_init()
+ * <br>
+ * <br><b>Inputs:</b><br>               UINT16 crc:     The crc so far
+ * <br>                                 UINT8 *pdata:   Pointer to a byte buffer.
+ * <br>                                 UINT32 ui_size: Size of the array
+ * <br>
+ * <br><b>Outputs:</b><br>              The updated crc
+ * <br>
+ * <br><b>Example:</b><br>              crc = utl_crc_update(crc, &frame[pos], 64);
+ */
+uint16_t utl_crc_update(uint16_t crc, const uint8_t *pdata, uint32_t ui_size) {
+#if UTL_CRC_METHOD == UTL_CRC_BITWISE
+    while (ui_size--) {
+        hash_crc_16ccitt(&crc, *pdata++);
+    }
+#elif UTL_CRC_METHOD == UTL_CRC_NIBBLE
+    uint8_t data;
+
+    while (ui_size--) {
+        data = *pdata++;
+        crc = (crc << 4) ^ crc_table_16[(crc >> 12) ^ (data >> 4)];
+        crc = (crc << 4) ^ crc_table_16[(crc >> 12) ^ (data & 0x0F)];
+    }
+#else
+#if UTL_CRC_METHOD == UTL_CRC_SLICE_4
+    while (ui_size >= 4) {
+        crc = crc_table_slice[3][(uint8_t)(pdata[0] ^ (crc >> 8))] ^
+              crc_table_slice[2][(uint8_t)(pdata[1] ^ crc)] ^
+              crc_table_slice[1][pdata[2]] ^
+              crc_table_slice[0][pdata[3]];
+        pdata += 4;
+        ui_size -= 4;
+    }
+#elif UTL_CRC_METHOD == UTL_CRC_SLICE_8
+    while (ui_size >= 8) {
+        crc = crc_table_slice[7][(uint8_t)(pdata[0] ^ (crc >> 8))] ^
+              crc_table_slice[6][(uint8_t)(pdata[1] ^ crc)] ^
+              crc_table_slice[5][pdata[2]] ^
+              crc_table_slice[4][pdata[3]] ^
+              crc_table_slice[3][pdata[4]] ^
+              crc_table_slice[2][pdata[5]] ^
+              crc_table_slice[1][pdata[6]] ^
+              crc_table_slice[0][pdata[7]];
+        pdata += 8;
+        ui_size -= 8;
+    }
+#endif
+    // Remaining bytes one table lookup at a time
+    while (ui_size--) {
+        crc = (crc << 8) ^ crc_table_256[(uint8_t)((crc >> 8) ^ *pdata++)];
+    }
+#endif
+    return crc;
+}
+
+/**
+ *     <b>Function prototype:</b><br>   UINT16 utl_crc_final(UINT16 crc)
+ * <br>
+ * <br><b>Description:</b><br>          Finishes an incremental CRC 16 CCITT calculation.
+ * <br>                                 CRC 16 CCITT has no final xor, the crc is returned as is.
+ * <br>
+ * <br><b>Precondition:</b><br>         crc must be started with utl_crc_init()
+ * <br>
+ * <br><b>Inputs:</b><br>               UINT16 crc:     The crc so far
+ * <br>
+ * <br><b>Outputs:</b><br>              The crc
+ * <br>
+ * <br><b>Example:</b><br>              crc = utl_crc_final(crc);
+ */
+uint16_t utl_crc_final(uint16_t crc) {
+    return crc;
+}
 
 /**
  *     <b>Function prototype:</b><br>   UINT16 utl_calc_crc(UINT8 *pdata, UINT32 ui_size)
@@ -500,12 +1629,94 @@ static void hash_crc_16ccitt(uint16_t *crc,uint8_t data) {
  * <br><b>Example:</b><br>              crc = utl_calc_crc(eeprom_data.raw, EEPROM_DATA_SIZE-2);    //Get crc
  */
 uint16_t utl_calc_crc(uint8_t *pdata, uint32_t ui_size) {
-   int n=0;
-   uint16_t wCrc = 0x1D0F;
-
-   for (n=0; n<ui_size ; n++) {
-      hash_crc_16ccitt(&wCrc,*pdata);
-      pdata++;
-   }
-   return wCrc;
+   uint16_t wCrc;
+
+   wCrc = utl_crc_init();
+   wCrc = utl_crc_update(wCrc, pdata, ui_size);
+   return utl_crc_final(wCrc);
+}
+
+/**
+ *     <b>Function prototype:</b><br>   UINT16 utl_cobs_encode(UINT8 *src, UINT16 len, UINT8 *dst)
+ * <br>
+ * <br><b>Description:</b><br>          Encodes a byte array with Consistent Overhead Byte Stuffing.
+ * <br>                                 The result contains no 0x00 bytes, so a 0x00 can be
+ * <br>                                 appended as frame delimiter. No delimiter is written.
+ * <br>
+ * <br><b>Precondition:</b><br>         dst must hold UTL_COBS_MAX_SIZE(len) bytes
+ * <br>
+ * <br><b>Inputs:</b><br>               UINT8 *src:     Pointer to the data to encode
+ * <br>                                 UINT16 len:     Length of the data
+ * <br>                                 UINT8 *dst:     Pointer to the output buffer
+ * <br>
+ * <br><b>Outputs:</b><br>              The length of the encoded data
+ * <br>
+ * <br><b>Example:</b><br>              size = utl_cobs_encode(record, sizeof(record), frame);
+ */
+uint16_t utl_cobs_encode(const uint8_t *src, uint16_t len, uint8_t *dst) {
+    uint8_t *code_ptr;
+    uint8_t code;
+    uint16_t size;
+
+    code_ptr = dst;                         // Place of the first code byte
+    code = 1;
+    size = 1;
+    while (len--) {
+        if (*src == 0) {
+            *code_ptr = code;               // Close the block at the zero
+            code_ptr = &dst[size++];
+            code = 1;
+        } else {
+            dst[size++] = *src;
+            code++;
+            if (code == 0xFF && len != 0) { // Block full
+                *code_ptr = code;
+                code_ptr = &dst[size++];
+                code = 1;
+            }
+        }
+        src++;
+    }
+    *code_ptr = code;
+    return size;
+}
+
+/**
+ *     <b>Function prototype:</b><br>   UINT16 utl_cobs_decode(UINT8 *src, UINT16 len, UINT8 *dst)
+ * <br>
+ * <br><b>Description:</b><br>          Decodes a Consistent Overhead Byte Stuffing frame,
+ * <br>                                 without the 0x00 delimiter.
+ * <br>
+ * <br><b>Precondition:</b><br>         dst must hold len bytes
+ * <br>
+ * <br><b>Inputs:</b><br>               UINT8 *src:     Pointer to the encoded frame
+ * <br>                                 UINT16 len:     Length of the encoded frame
+ * <br>                                 UINT8 *dst:     Pointer to the output buffer
+ * <br>
+ * <br><b>Outputs:</b><br>              The length of the decoded data, UTL_COBS_ERROR for an invalid frame
+ * <br>
+ * <br><b>Example:</b><br>              size = utl_cobs_decode(frame, frame_size, record);
+ */
+uint16_t utl_cobs_decode(const uint8_t *src, uint16_t len, uint8_t *dst) {
+    uint16_t in, size;
+    uint8_t code, i;
+
+    in = 0;
+    size = 0;
+    while (in < len) {
+        code = src[in++];
+        if (code == 0 || in + code - 1 > len) {
+            return UTL_COBS_ERROR;          // Zero in the frame or block past the end
+        }
+        for (i = 1; i < code; i++) {
+            if (src[in] == 0) {
+                return UTL_COBS_ERROR;
+            }
+            dst[size++] = src[in++];
+        }
+        if (code != 0xFF && in < len) {     // Block ended at a zero
+            dst[size++] = 0;
+        }
+    }
+    return size;
 }
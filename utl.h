@@ -2,24 +2,98 @@
 #define UTL_H
 
 #include <stdint.h>
+#include <stdarg.h>
+
+// CRC 16 CCITT calculation methods
+#define UTL_CRC_BITWISE     0       // 8 shift/xor steps per byte, no table
+#define UTL_CRC_NIBBLE      1       // 16 entry table (32 bytes), 2 lookups per byte
+#define UTL_CRC_TABLE       2       // 256 entry table (512 bytes), 1 lookup per byte
+#define UTL_CRC_SLICE_4     3       // 4x256 entry table in RAM, 4 bytes per step (host builds)
+#define UTL_CRC_SLICE_8     4       // 8x256 entry table in RAM, 8 bytes per step (host builds)
+
+// Select the CRC method, all methods give the same result
+#ifndef UTL_CRC_METHOD
+#define UTL_CRC_METHOD      UTL_CRC_TABLE
+#endif
+
+#define UTL_CRC_SEED        0x1D0F  // Start value of the crc
+
+#define UTL_UPPERCASE       0       // Hex digits A-F
+#define UTL_LOWERCASE       1       // Hex digits a-f
+#define UTL_POW2_MAX_WIDTH  32      // Max padded width of the bin/oct/hex converters
+
+#define UTL_COBS_MAX_SIZE(len)  ((len) + (len) / 254 + 1)  // Max encoded size, without delimiter
+#define UTL_COBS_ERROR      0xFFFF  // utl_cobs_decode result for an invalid frame
+#define UTL_DATETIME_LENGTH 19      // "YYYY-MM-DD hh:mm:ss", without the null character
+
+// Status of the utl_parse_ functions
+#define UTL_PARSE_OK        0       // Value parsed
+#define UTL_PARSE_INVALID   1       // No digit at the start, or a wrong radix
+#define UTL_PARSE_OVERFLOW  2       // Too many digits, the value is saturated
+
+// Parse 8 decimal or hex digits per step on little endian hosts
+#ifndef UTL_PARSE_SWAR
+#if !defined(__XC16__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define UTL_PARSE_SWAR      1
+#else
+#define UTL_PARSE_SWAR      0
+#endif
+#endif
+
+// Cache of utl_datetime, the text and the fields it was written from
+typedef struct {
+    char text[UTL_DATETIME_LENGTH + 1];
+    uint32_t date;          // Year, month and day in the text
+    uint16_t hour_min;      // Hour and minute in the text
+} utl_datetime_t;
 
 char *utl_itoa(int value, char *str, uint8_t radix);
 char *utl_uitoa(unsigned int value, char *str, uint8_t radix);
 char *utl_ltoa(long value, char *str, uint8_t radix);
 char *utl_ultoa(unsigned long value, char *str, uint8_t radix);
-char *utl_lltoa(long value, char *str, uint8_t radix);
+char *utl_lltoa(long long value, char *str, uint8_t radix);
 
 char *utl_i32toa(int32_t value, char *str, uint8_t radix);
 char *utl_ui32toa(uint32_t value, char *str, uint8_t radix);
 
+uint8_t utl_dec_digits(uint32_t value);
+void utl_ui32toa_fixed(uint32_t value, char *str, uint8_t digits);
+char *utl_ui32toa_dec(uint32_t value, char *str);
+char *utl_i32toa_dec(int32_t value, char *str);
+char *utl_u64toa(uint64_t value, char *str);
+char *utl_i64toa(int64_t value, char *str);
+char *utl_ufixtoa(uint32_t value, char *str, uint8_t scale_pow10, uint8_t decimals);
+char *utl_fixtoa(int32_t value, char *str, uint8_t scale_pow10, uint8_t decimals);
+char *utl_fixtoa_si(int32_t value, char *str, uint8_t scale_pow10, uint8_t decimals);
+void utl_datetime_init(utl_datetime_t *datetime);
+const char *utl_datetime(utl_datetime_t *datetime, uint16_t year, uint8_t month, uint8_t day,
+                         uint8_t hour, uint8_t min, uint8_t sec);
+
+char *utl_ui32toa_hex(uint32_t value, char *str, uint8_t width, uint8_t lowercase);
+uint8_t utl_hex_digits(uint32_t value);
+void utl_ui32toa_hex_fixed(uint32_t value, char *str, uint8_t digits, uint8_t lowercase);
+char *utl_ui32toa_oct(uint32_t value, char *str, uint8_t width);
+char *utl_ui32toa_bin(uint32_t value, char *str, uint8_t width);
+
 char *utl_itoa_l(int value, char *str, uint8_t radix, uint8_t len);
 char *utl_i32toa_l(uint32_t value, char *str, uint8_t radix, uint8_t len);
 
+int utl_vsnprintf(char *str, uint16_t size, const char *fmt, va_list args);
+int utl_snprintf(char *str, uint16_t size, const char *fmt, ...);
+
 int32_t utl_atoi32(char *str, uint8_t radix);
 uint32_t utl_atoui32(char *str, uint8_t radix);
 int utl_hstoi(char *s);
+const char *utl_parse_u32(const char *str, uint16_t len, uint8_t radix, uint32_t *value, uint8_t *status);
+const char *utl_parse_i32(const char *str, uint16_t len, uint8_t radix, int32_t *value, uint8_t *status);
 
 uint16_t utl_calc_crc(uint8_t *pdata, uint32_t ui_size);
+uint16_t utl_crc_init(void);
+uint16_t utl_crc_update(uint16_t crc, const uint8_t *pdata, uint32_t ui_size);
+uint16_t utl_crc_final(uint16_t crc);
+
+uint16_t utl_cobs_encode(const uint8_t *src, uint16_t len, uint8_t *dst);
+uint16_t utl_cobs_decode(const uint8_t *src, uint16_t len, uint8_t *dst);
 
 
 #endif